@@ -0,0 +1,319 @@
+// Benchmarks for the grid and simulation hot paths: lab2_bench [max size] [results file].
+// Sweeps square maps from 800x800 up to max size (default 16000) and several obstacle counts,
+// printing ns/op, throughput and heap allocations per op, and writes the same rows as CSV to
+// results file (default bench_results.csv) so runs of different builds can be diffed. The tiled
+// grid and binary snapshot rows use scratch files next to it, <results file>.tiles and .grid,
+// removed at the end.
+// Build it optimized: make bench CXXFLAGS="-g -O2 -mavx2"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "sim.h"
+#include "tiled_grid.h"
+
+// Every heap allocation in the process goes through here, so each benchmark can report what it
+// allocated. All the replaceable forms are covered (array, nothrow, over-aligned) so no allocation
+// slips past the counters, and they share one allocate/release pair kept out of line: inlined
+// into a new-expression's caller, std::free trips -Wmismatched-new-delete
+static std::atomic<uint64_t> alloc_count{0};
+static std::atomic<uint64_t> alloc_bytes{0};
+
+__attribute__((noinline)) static void* counted_alloc(size_t size, size_t align) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    size = size ? size : 1;
+    if (align <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    // aligned_alloc wants a size that is a multiple of the alignment
+    return std::aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+__attribute__((noinline)) static void counted_free(void* p) { std::free(p); }
+
+static void* counted_alloc_or_throw(size_t size, size_t align) {
+    if (void* p = counted_alloc(size, align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return counted_alloc_or_throw(size, 0); }
+void* operator new[](size_t size) { return counted_alloc_or_throw(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return counted_alloc_or_throw(size, (size_t)al); }
+void* operator new[](size_t size, std::align_val_t al) { return counted_alloc_or_throw(size, (size_t)al); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return counted_alloc(size, (size_t)al); }
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return counted_alloc(size, (size_t)al); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+
+// Minimum timed wall time per benchmark
+const double bench_min_seconds = 0.2;
+// Cap on the whole of a measure_each run, untimed setup included
+const double bench_max_seconds = 5.0;
+
+struct bench_row {
+    std::string name;
+    int width, height, objects;
+    uint64_t ops;
+    double ns_per_op;
+    double items_per_op;                    // cells, boxes or steps handled by one op
+    double allocs_per_op, bytes_per_op;
+};
+
+static std::vector<bench_row> rows;
+static volatile int64_t sink;               // keeps results of timed calls alive
+
+static void report(const bench_row& row) {
+    rows.push_back(row);
+    const double items_per_s = row.ns_per_op > 0 ? row.items_per_op*1e9/row.ns_per_op : 0.0;
+    std::fprintf(stderr, "%-20s %6dx%-6d %5d obj %12.1f ns/op %14.4g items/s %10.2f allocs/op %12.0f B/op\n",
+                 row.name.c_str(), row.width, row.height, row.objects, row.ns_per_op, items_per_s,
+                 row.allocs_per_op, row.bytes_per_op);
+}
+
+// Time a cheap op in doubling batches until one batch runs for bench_min_seconds
+template <typename F>
+static bench_row measure(const std::string& name, int w, int h, int objects, double items, F op) {
+    op();
+    for (uint64_t reps = 1; ; reps *= 2) {
+        const uint64_t count0 = alloc_count.load(), bytes0 = alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < reps; i++) {
+            op();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns >= bench_min_seconds*1e9 || reps >= (1ULL << 32)) {
+            return bench_row{name, w, h, objects, reps, ns/reps, items,
+                             (double)(alloc_count.load() - count0)/reps, (double)(alloc_bytes.load() - bytes0)/reps};
+        }
+    }
+}
+
+// Time an expensive op one call at a time, running the untimed setup before each call. Stops
+// after bench_min_seconds of timed calls, so an op slower than that runs once, or when setup
+// has eaten bench_max_seconds in all
+template <typename S, typename F>
+static bench_row measure_each(const std::string& name, int w, int h, int objects, double items, S setup, F op) {
+    uint64_t reps = 0, count = 0, bytes = 0;
+    double ns = 0.0;
+    const auto begin = std::chrono::steady_clock::now();
+    while (ns < bench_min_seconds*1e9 &&
+           (reps == 0 || std::chrono::steady_clock::now() - begin < std::chrono::duration<double>(bench_max_seconds))) {
+        setup();
+        const uint64_t count0 = alloc_count.load(), bytes0 = alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        op();
+        ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        count += alloc_count.load() - count0;
+        bytes += alloc_bytes.load() - bytes0;
+        reps++;
+    }
+    return bench_row{name, w, h, objects, reps, ns/reps, items, (double)count/reps, (double)bytes/reps};
+}
+
+// Swallows the per-step console messages while timing, without allocating
+struct null_buffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+struct mute_cout {
+    null_buffer null;
+    std::streambuf* saved;
+    mute_cout(): saved(std::cout.rdbuf(&null)) {}
+    ~mute_cout() { std::cout.rdbuf(saved); }
+};
+
+static void bench_grid(int size, int objects) {
+    mute_cout mute;
+    // The sim's own collision check needs an episode context; its grid is swapped for one of this size
+    episode_context ctx;
+    ctx.verbose = false;
+    ctx.grid = grid_util(size, size, min_obj_size, max_obj_size);
+    ctx.grid.set_footprint(2*radius, 2*radius);
+    grid_util& grid = ctx.grid;
+    random_generator rand_gen(1, RNG_XOSHIRO256);
+
+    report(measure_each("create_objects", size, size, objects, objects,
+                 [&] { grid.clear(); },
+                 [&] { ctx.objects = grid.create_objects(rand_gen, occupancy_tol, objects, false); }));
+
+    // Query boxes the size of obstacles, and robot boxes, spread over the whole map
+    const int queries = 4096;
+    std::vector<Object> boxes(queries), robots(queries);
+    for (int i = 0; i < queries; i++) {
+        boxes[i] = Object{rand_gen.create_random(0, size - max_obj_size - 1), rand_gen.create_random(0, size - max_obj_size - 1),
+                          rand_gen.create_random(min_obj_size, max_obj_size), rand_gen.create_random(min_obj_size, max_obj_size)};
+        robots[i] = Object{rand_gen.create_random(0, size - 2*radius - 1), rand_gen.create_random(0, size - 2*radius - 1), 2*radius, 2*radius};
+    }
+    int q = 0;
+    report(measure("is_occupied", size, size, objects, 1, [&] {
+        const Object& b = boxes[q++ & (queries-1)];
+        sink = sink + grid.is_occupied(occupancy_tol, b.x, b.y, b.width, b.height);
+    }));
+    // The grid's own four-corner check, then the sim's collision models
+    report(measure("grid_is_collision", size, size, objects, 1, [&] {
+        sink = sink + grid.is_collision(robots[q++ & (queries-1)]);
+    }));
+    const char* models[] = {"box", "circle", "objects"};
+    for (const char* model : models) {
+        parse_collision(model, ctx.options.collision);
+        index_obstacles(ctx);
+        report(measure(std::string("is_collision_") + model, size, size, objects, 1, [&] {
+            sink = sink + is_collision(ctx, robots[q++ & (queries-1)]);
+        }));
+    }
+}
+
+// The same placement and queries on the file-backed tiled grid; each create_objects op maps a
+// fresh, empty backing file at `path`
+static void bench_tiled(const std::string& path, int size, int objects) {
+    random_generator rand_gen(1, RNG_XOSHIRO256);
+    std::unique_ptr<tiled_grid> grid;
+    report(measure_each("tiled_create_objects", size, size, objects, objects,
+                 [&] {
+                     grid.reset();
+                     grid.reset(new tiled_grid(path, size, size, min_obj_size, max_obj_size));
+                 },
+                 [&] { grid->create_objects(rand_gen, occupancy_tol, objects, false); }));
+    if (!grid->is_open()) {
+        return;
+    }
+
+    const int queries = 4096;
+    std::vector<Object> boxes(queries), robots(queries);
+    for (int i = 0; i < queries; i++) {
+        boxes[i] = Object{rand_gen.create_random(0, size - max_obj_size - 1), rand_gen.create_random(0, size - max_obj_size - 1),
+                          rand_gen.create_random(min_obj_size, max_obj_size), rand_gen.create_random(min_obj_size, max_obj_size)};
+        robots[i] = Object{rand_gen.create_random(0, size - 2*radius - 1), rand_gen.create_random(0, size - 2*radius - 1), 2*radius, 2*radius};
+    }
+    int q = 0;
+    report(measure("tiled_is_occupied", size, size, objects, 1, [&] {
+        const Object& b = boxes[q++ & (queries-1)];
+        sink = sink + grid->is_occupied(occupancy_tol, b.x, b.y, b.width, b.height);
+    }));
+    report(measure("tiled_is_collision", size, size, objects, 1, [&] {
+        sink = sink + grid->is_collision(robots[q++ & (queries-1)]);
+    }));
+}
+
+// Ops whose cost depends on the map size only; the snapshot round trip goes through `path`
+static void bench_map(const std::string& path, int size) {
+    mute_cout mute;
+    grid_util grid(size, size, min_obj_size, max_obj_size);
+    random_generator rand_gen(1, RNG_XOSHIRO256);
+
+    // Each op drops a batch of obstacles onto a freshly generated map, so every op sees the same
+    // starting grid instead of one that keeps filling up
+    const unsigned placements = 64;
+    const unsigned span = size - max_obj_size;
+    const double area = (double)(max_obj_size + 2*occupancy_tol)*(max_obj_size + 2*occupancy_tol);
+    report(measure_each("occupy_grid", size, size, num_objects, placements*area,
+                 [&] {
+                     grid.clear();
+                     rand_gen.seed(1);
+                     grid.create_objects(rand_gen, occupancy_tol, num_objects, false);
+                 },
+                 [&] {
+                     for (unsigned q = 0; q < placements; q++) {
+                         const int x = (q*7919u) % span, y = (q*104729u) % span;
+                         grid.occupy_grid(occupancy_tol, x, y, max_obj_size, max_obj_size, CELL_OBSTACLE, "obstacle");
+                     }
+                 }));
+    // Formatting and write calls without disk traffic
+    report(measure_each("writeGridToCSV", size, size, num_objects, (double)size*size,
+                 [] {},
+                 [&] { grid.writeGridToCSV("/dev/null"); }));
+    report(measure_each("save_binary", size, size, num_objects, (double)size*size,
+                 [] {},
+                 [&] { sink = sink + grid.save_binary(path, 1); }));
+    // Maps the snapshot in place and rebuilds the grid's indexes from it
+    grid_util loaded(size, size, min_obj_size, max_obj_size);
+    report(measure_each("load_binary", size, size, num_objects, (double)size*size,
+                 [] {},
+                 [&] { sink = sink + loaded.load_binary(path); }));
+}
+
+static void bench_random() {
+    random_generator mt(1, RNG_MT19937), xoshiro(1, RNG_XOSHIRO256);
+    report(measure("create_random_mt", 0, 0, 0, 1, [&] { sink = sink + mt.create_random(0, width); }));
+    report(measure("create_random_xo", 0, 0, 0, 1, [&] { sink = sink + xoshiro.create_random(0, width); }));
+}
+
+// One full headless episode per policy on the fixed-size lab map
+static void bench_episodes() {
+    const char* policies[] = {"greedy", "astar", "jps", "dstar", "flow"};
+    for (const char* name : policies) {
+        mute_cout mute;
+        episode_context ctx;
+        ctx.verbose = false;
+        parse_policy(name, ctx.options.policy);
+        uint64_t seed = 1;
+        int steps = 0, episodes = 0;
+        bench_row row = measure_each(std::string("episode_") + name, width, height, num_objects, 0.0,
+                                     [&] { ctx.rand_gen.seed(seed++); },
+                                     [&] { steps += run_episode(ctx).steps; episodes++; });
+        row.items_per_op = (double)steps/episodes;
+        report(row);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    int max_size = (argc > 1) ? std::atoi(argv[1]) : 16000;
+    std::string filename = (argc > 2) ? argv[2] : "bench_results.csv";
+    // Backing file of the tiled grid benchmarks, removed at the end
+    const std::string tiles_path = filename + ".tiles";
+    // Snapshot written and loaded by the save_binary / load_binary rows, removed at the end
+    const std::string grid_path = filename + ".grid";
+    const int sizes[] = {800, 2000, 4000, 8000, 16000};
+    const int object_counts[] = {num_objects, 150, 1500};
+
+    bench_random();
+    for (int size : sizes) {
+        if (size > max_size) {
+            break;
+        }
+        for (int objects : object_counts) {
+            bench_grid(size, objects);
+            bench_tiled(tiles_path, size, objects);
+        }
+        bench_map(grid_path, size);
+    }
+    bench_episodes();
+    std::remove(tiles_path.c_str());
+    std::remove(grid_path.c_str());
+
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return 1;
+    }
+    std::fprintf(file, "benchmark,width,height,objects,ops,ns_per_op,items_per_s,allocs_per_op,bytes_per_op\n");
+    for (const bench_row& row : rows) {
+        std::fprintf(file, "%s,%d,%d,%d,%llu,%.2f,%.6g,%.3f,%.1f\n", row.name.c_str(), row.width, row.height, row.objects,
+                     (unsigned long long)row.ops, row.ns_per_op, row.ns_per_op > 0 ? row.items_per_op*1e9/row.ns_per_op : 0.0,
+                     row.allocs_per_op, row.bytes_per_op);
+    }
+    std::fclose(file);
+    std::cerr << "Wrote " << rows.size() << " results to " << filename << std::endl;
+    return 0;
+}
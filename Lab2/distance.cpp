@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <thread>
+#include "distance.h"
+
+// d*d in 64 bits, saturated like the rest of the field: columns taller than 46340 cells would
+// overflow an int
+static inline int32_t clamped_square(int64_t d) {
+    return (int32_t)std::min<int64_t>(d*d, INT32_MAX);
+}
+
+// Column pass: squared distance along y to the nearest obstacle in the same column. Obstacle
+// positions come straight from the bitmap words, and each gap between two of them is filled
+// in one branch-free loop. INT32_MAX where the column has no obstacle
+void distance_field::columns(const grid_util& grid, int x0, int x1) {
+    const int words = grid.obstacle_row_words();
+    for (int x = x0; x < x1; x++) {
+        const uint64_t* bits = grid.obstacle_row(x);
+        int32_t* col = &dist2[(size_t)x*height];
+        int prev = -1;                      // last obstacle seen, -1 before the first
+        for (int i = 0; i <= words; i++) {
+            uint64_t w = (i < words) ? bits[i] : 0;
+            while (true) {
+                // The bit past the last word stands for the far map edge
+                const bool edge = (w == 0);
+                const int next = edge ? height : i*64 + __builtin_ctzll(w);
+                if (edge && i < words) {
+                    break;
+                }
+                if (prev < 0 && edge) {
+                    std::fill(col, col + height, INT32_MAX);
+                }
+                else if (prev < 0) {
+                    for (int y = 0; y < next; y++) {
+                        col[y] = clamped_square(next - y);
+                    }
+                }
+                else if (edge) {
+                    for (int y = prev; y < height; y++) {
+                        col[y] = clamped_square(y - prev);
+                    }
+                }
+                else {
+                    for (int y = prev; y < next; y++) {
+                        col[y] = clamped_square(std::min(y - prev, next - y));
+                    }
+                }
+                if (edge) {
+                    break;
+                }
+                prev = next;
+                w &= w - 1;
+            }
+        }
+    }
+}
+
+// Row pass (Felzenszwalb-Huttenlocher): along each row, the lower envelope of the parabolas
+// (x - q)^2 + f(q) gives the exact squared Euclidean distance. Rows are strided in the x-major
+// layout, so they are gathered into a local buffer a band of row_band at a time, which reads
+// whole cache lines of each column instead of one value per line
+void distance_field::rows(int y0, int y1) {
+    const int row_band = 16;
+    std::vector<int32_t> band((size_t)row_band*width), d(width);
+    std::vector<int> v(width);              // parabola vertices on the envelope
+    std::vector<double> z(width + 1);       // boundaries between them
+    for (int yb = y0; yb < y1; yb += row_band) {
+        const int rows_in_band = std::min(row_band, y1 - yb);
+        for (int q = 0; q < width; q++) {
+            const int32_t* col = &dist2[(size_t)q*height + yb];
+            for (int r = 0; r < rows_in_band; r++) {
+                band[(size_t)r*width + q] = col[r];
+            }
+        }
+        for (int r = 0; r < rows_in_band; r++) {
+            int32_t* f = &band[(size_t)r*width];
+            int k = -1;
+            for (int q = 0; q < width; q++) {
+                if (f[q] == INT32_MAX) {
+                    continue;               // no obstacle in this column, never on the envelope
+                }
+                double s = 0.0;
+                while (k >= 0) {
+                    const int p = v[k];
+                    s = ((double)f[q] + (double)q*q - (double)f[p] - (double)p*p) / (2.0*(q - p));
+                    if (s > z[k]) {
+                        break;
+                    }
+                    k--;
+                }
+                k++;
+                v[k] = q;
+                z[k] = (k == 0) ? -1e300 : s;
+                z[k + 1] = 1e300;
+            }
+            if (k < 0) {
+                continue;                   // row stays INT32_MAX: the map has no obstacles
+            }
+            int j = 0;
+            for (int q = 0; q < width; q++) {
+                while (z[j + 1] < q) {
+                    j++;
+                }
+                const int64_t dx = q - v[j];
+                d[q] = (int32_t)std::min<int64_t>(dx*dx + f[v[j]], INT32_MAX);
+            }
+            std::copy(d.begin(), d.end(), f);
+        }
+        for (int q = 0; q < width; q++) {
+            int32_t* col = &dist2[(size_t)q*height + yb];
+            for (int r = 0; r < rows_in_band; r++) {
+                col[r] = band[(size_t)r*width + q];
+            }
+        }
+    }
+}
+
+// Recompute the field from the grid's obstacle bitmap. Both passes split their lines evenly
+// across threads; the second pass only starts once every column is done
+void distance_field::build(const grid_util& grid, int threads) {
+    width = grid.width();
+    height = grid.height();
+    dist2.resize((size_t)width*height);
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+        threads = (threads > 0) ? threads : 1;
+    }
+
+    auto split = [threads](int n, auto&& pass) {
+        const int parts = std::max(1, std::min(threads, n));
+        std::vector<std::thread> pool;
+        for (int t = 1; t < parts; t++) {
+            pool.emplace_back(pass, (int)((int64_t)n*t/parts), (int)((int64_t)n*(t + 1)/parts));
+        }
+        pass(0, n/parts);
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    };
+    split(width, [&](int x0, int x1) { columns(grid, x0, x1); });
+    split(height, [&](int y0, int y1) { rows(y0, y1); });
+}
@@ -0,0 +1,32 @@
+// Exact Euclidean distance transform of the obstacle layer, built once per map.
+// Each position holds the squared distance to the nearest obstacle cell, so a circular body
+// of radius r centred on (x, y) touches an obstacle exactly when squared(x, y) < r*r
+#ifndef DISTANCE
+#define DISTANCE
+
+#include <cstdint>
+#include <vector>
+#include "utils.h"
+
+class distance_field {
+    int width, height;
+    std::vector<int32_t> dist2;             // [x][y], saturates at INT32_MAX (no obstacle at all)
+    void columns(const grid_util&, int, int);
+    void rows(int, int);
+    public:
+        distance_field(): width(0), height(0) {}
+        // threads: 0 = all cores. Passes are split over columns, then rows
+        void build(const grid_util&, int threads = 1);
+        int width_cells() const { return width; }
+        int height_cells() const { return height; }
+        // Positions off the map read as obstacle-free, matching the clipped box checks
+        int32_t squared(int x, int y) const {
+            if (x < 0 || y < 0 || x >= width || y >= height) {
+                return INT32_MAX;
+            }
+            return dist2[(size_t)x*height + y];
+        }
+        bool circle_hits_obstacle(int cx, int cy, int r) const { return squared(cx, cy) < (int64_t)r*r; }
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifdef INSTRUMENT
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "instrument.h"
+
+namespace prof {
+
+bool tracing = false;
+
+struct trace_record {
+    uint64_t start, end;
+    prof_phase phase;
+};
+
+// Per-thread state lives in the registry, not on the thread, so totals survive thread exit
+struct thread_state {
+    thread_block block;
+    std::vector<trace_record> events;
+};
+
+struct registry {
+    std::mutex lock;
+    std::vector<std::unique_ptr<thread_state>> threads;
+    // Reference point for converting ticks to time and for trace timestamps
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+    registry(): start_ticks(now_ticks()), start_time(std::chrono::steady_clock::now()) {}
+};
+
+static registry& reg() {
+    static registry r;
+    return r;
+}
+
+static thread_local thread_state* state = nullptr;
+
+thread_block* register_thread() {
+    registry& r = reg();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.threads.push_back(std::unique_ptr<thread_state>(new thread_state()));
+    state = r.threads.back().get();
+    state->block = thread_block{};
+    state->block.thread_index = (int)r.threads.size() - 1;
+    return &state->block;
+}
+
+// The timer's destructor has already registered this thread
+void trace_event(prof_phase phase, uint64_t start, uint64_t end) {
+    state->events.push_back(trace_record{start, end, phase});
+}
+
+// Nanoseconds per tick: the clock's period, or for the cycle counter the rate seen since startup
+static double ns_per_tick() {
+#if defined(INSTRUMENT_RDTSC) && defined(__x86_64__)
+    registry& r = reg();
+    const uint64_t ticks = now_ticks() - r.start_ticks;
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - r.start_time).count();
+    return ticks ? ns/ticks : 0.0;
+#else
+    return 1e9*std::chrono::steady_clock::period::num/std::chrono::steady_clock::period::den;
+#endif
+}
+
+static const char* counter_names[COUNTER_COUNT] = {
+    "episodes", "steps", "placement_retries", "placement_failures",
+    "collision_checks", "collisions", "avoidance_iterations", "frames"
+};
+static const char* phase_names[PHASE_COUNT] = {
+    "episode", "map_generation", "drive", "render"
+};
+
+}
+
+void prof_enable_trace(bool enable) {
+    prof::tracing = enable;
+}
+
+// Call once the worker threads have been joined
+bool prof_write_summary(const std::string& filename) {
+    using namespace prof;
+    registry& r = reg();
+    std::lock_guard<std::mutex> guard(r.lock);
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    uint64_t counters[COUNTER_COUNT] = {}, calls[PHASE_COUNT] = {}, ticks[PHASE_COUNT] = {};
+    for (const std::unique_ptr<thread_state>& t : r.threads) {
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            counters[c] += t->block.counters[c];
+        }
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            calls[p] += t->block.phase_calls[p];
+            ticks[p] += t->block.phase_ticks[p];
+        }
+    }
+    const double tick_ns = ns_per_tick();
+    const double steps = (double)counters[COUNTER_STEPS];
+
+    std::fprintf(file, "{\n  \"threads\": %zu,\n  \"counters\": {\n", r.threads.size());
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        std::fprintf(file, "    \"%s\": %llu,\n", counter_names[c], (unsigned long long)counters[c]);
+    }
+    std::fprintf(file, "    \"collision_checks_per_step\": %.4f\n  },\n  \"phases\": {\n",
+                 steps > 0 ? counters[COUNTER_COLLISION_CHECKS]/steps : 0.0);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const double ms = ticks[p]*tick_ns*1e-6;
+        std::fprintf(file, "    \"%s\": {\"calls\": %llu, \"total_ms\": %.3f, \"mean_ms\": %.6f}%s\n", phase_names[p],
+                     (unsigned long long)calls[p], ms, calls[p] ? ms/calls[p] : 0.0, (p+1 < PHASE_COUNT) ? "," : "");
+    }
+    std::fprintf(file, "  }\n}\n");
+    return std::fclose(file) == 0;
+}
+
+// Complete ("X") events in microseconds since startup, one track per thread
+bool prof_write_trace(const std::string& filename) {
+    using namespace prof;
+    registry& r = reg();
+    std::lock_guard<std::mutex> guard(r.lock);
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    const double tick_us = ns_per_tick()*1e-3;
+    bool first = true;
+    std::fprintf(file, "{\"traceEvents\": [\n");
+    for (const std::unique_ptr<thread_state>& t : r.threads) {
+        for (const trace_record& e : t->events) {
+            std::fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                         first ? "" : ",\n", phase_names[e.phase], t->block.thread_index,
+                         (int64_t)(e.start - r.start_ticks)*tick_us, (e.end - e.start)*tick_us);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+    return std::fclose(file) == 0;
+}
+
+void prof_begin_run() {
+    prof::reg();
+    prof_enable_trace(std::getenv("LAB2_TRACE") != nullptr);
+}
+
+void prof_end_run() {
+    const char* profile = std::getenv("LAB2_PROFILE");
+    const std::string summary_file = profile ? profile : "lab2_profile.json";
+    if (prof_write_summary(summary_file)) {
+        std::cerr << "# profile written to " << summary_file << std::endl;
+    }
+    const char* trace = std::getenv("LAB2_TRACE");
+    if (trace && prof_write_trace(trace)) {
+        std::cerr << "# trace written to " << trace << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+// Hot-path counters and per-phase timers. Build with -DINSTRUMENT (e.g. make CXXFLAGS="-g -O2
+// -DINSTRUMENT") to enable; otherwise PROF_COUNT and PROF_SCOPE expand to nothing and the
+// dump functions are empty inlines. Add -DINSTRUMENT_RDTSC on x86 to time with the cycle
+// counter instead of steady_clock; ticks are converted to time once, at dump.
+// Each thread bumps its own block of counters, so the hot paths never share a cache line;
+// the dumps sum the blocks of every thread that ever recorded something
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <cstdint>
+#include <string>
+
+enum prof_counter {
+    COUNTER_EPISODES,
+    COUNTER_STEPS,
+    COUNTER_PLACEMENT_RETRIES,              // rejected spawn spots in create_object / place_objects
+    COUNTER_PLACEMENT_FAILURES,             // objects dropped after 5000 rejected spots
+    COUNTER_COLLISION_CHECKS,               // is_collision calls
+    COUNTER_COLLISIONS,
+    COUNTER_AVOIDANCE_ITERATIONS,           // perpendicular shifts in obstacle_avoidance
+    COUNTER_FRAMES,                         // rendered frames
+    COUNTER_COUNT
+};
+
+enum prof_phase {
+    PHASE_EPISODE,                          // all of run_episode
+    PHASE_MAP_GENERATION,                   // robot, goal, obstacles and per-map indexes
+    PHASE_DRIVE,                            // planning and motion until goal or step cap
+    PHASE_RENDER,                           // one window frame
+    PHASE_COUNT
+};
+
+#ifdef INSTRUMENT
+
+#include <chrono>
+#if defined(INSTRUMENT_RDTSC) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace prof {
+
+struct thread_block {
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t phase_calls[PHASE_COUNT];
+    uint64_t phase_ticks[PHASE_COUNT];
+    int thread_index;
+};
+
+thread_block* register_thread();
+
+// This thread's block, registered on first use
+inline thread_block& local() {
+    thread_local thread_block* block = register_thread();
+    return *block;
+}
+
+// Append a finished scope to this thread's trace buffer; only called while tracing
+void trace_event(prof_phase, uint64_t, uint64_t);
+extern bool tracing;
+
+inline uint64_t now_ticks() {
+#if defined(INSTRUMENT_RDTSC) && defined(__x86_64__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+class scoped_timer {
+    prof_phase phase;
+    uint64_t start;
+    public:
+        explicit scoped_timer(prof_phase p): phase(p), start(now_ticks()) {}
+        ~scoped_timer() {
+            const uint64_t end = now_ticks();
+            thread_block& block = local();
+            block.phase_calls[phase]++;
+            block.phase_ticks[phase] += end - start;
+            if (tracing) {
+                trace_event(phase, start, end);
+            }
+        }
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator=(const scoped_timer&) = delete;
+};
+
+}
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#define PROF_COUNT(counter, n) (prof::local().counters[counter] += (uint64_t)(n))
+#define PROF_SCOPE(phase) prof::scoped_timer PROF_CONCAT(prof_scope_, __LINE__)(phase)
+
+// Record every timed scope from now on for write_trace. Off by default: the trace grows with the run
+void prof_enable_trace(bool);
+// Totals of every thread as JSON: counters, and calls / total / mean milliseconds per phase
+bool prof_write_summary(const std::string&);
+// Chrome trace-event JSON of the recorded scopes, for chrome://tracing or Perfetto
+bool prof_write_trace(const std::string&);
+// Per-run hooks for the mains: begin turns on tracing when LAB2_TRACE names a trace file, end
+// writes the summary to LAB2_PROFILE (default lab2_profile.json) and the trace if one was asked for
+void prof_begin_run();
+void prof_end_run();
+
+#else
+
+#define PROF_COUNT(counter, n) ((void)0)
+#define PROF_SCOPE(phase) ((void)0)
+
+inline void prof_enable_trace(bool) {}
+inline bool prof_write_summary(const std::string&) { return false; }
+inline bool prof_write_trace(const std::string&) { return false; }
+inline void prof_begin_run() {}
+inline void prof_end_run() {}
+
+#endif
+
+#endif
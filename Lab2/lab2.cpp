@@ -1,224 +1,124 @@
-#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <random>
+#include <string>
 #include <vector>
-#include "utils.h"
+#include "sim.h"
+#ifndef HEADLESS
 #include "render.h"
-
-//===== Main parameters =====
-const int width {800}, height {800};        // Width and height of the environment
-const int radius {10};                      // Radius of the robot's circular body
-const int min_obj_size {50};                // Minimum object dimension
-const int max_obj_size {100};               // Maximum object dimension
-const int goal_width {100};                 // Goal width
-const int goal_height {100};                // Goal height
-const int robot_tol {200};                  // Tolerance for robot spawn point
-const int occupancy_tol {50};               // Minimum distance between all objects that spawn
-const int goal_tol {100};                   // Minimum distance in x,y between robot and goal
-const int robot_y_min {500};                // Minimum robot y position
-const int goal_y_max {300};                 // Maximum goal y position
-int num_objects {15};                       // Number of objects in environment
-
-// Grid utility class
-grid_util grid(width, height, min_obj_size, max_obj_size);
-
-// Random generator
-random_generator rand_gen;
-
-// Vector of velocity commands
-std::vector<std::vector<int>> robot_pos;
-
-// Did mission succeed?
-bool succeed = false;
-
-// Check to see if it collides with the goal
-bool is_goal_detected(const Object& robot, const Object& goal) {
-    return !(robot.x + robot.width <= goal.x ||
-             robot.x >= goal.x + goal_width ||
-             robot.y + robot.height <= goal.y ||
-             robot.y >= goal.y + goal_height);
-}
-
-// Assuming each grid cell represents 1 pixel
-const int grid_cell_width = 1;
-const int grid_cell_height = 1;
-
-// This function checks for collisions by looking at the robot's corners and edges on the grid
-bool is_collision(Object robot, grid_util &grid) {
-    int robot_width = robot.width;
-    int robot_height = robot.height;
-
-    // Convert robot's position to grid coordinates
-    int grid_top_left_x = robot.x / grid_cell_width;
-    int grid_top_left_y = robot.y / grid_cell_height;
-    
-    int grid_top_right_x = (robot.x + robot_width) / grid_cell_width;
-    int grid_top_right_y = grid_top_left_y;
-    
-    int grid_bottom_left_x = grid_top_left_x;
-    int grid_bottom_left_y = (robot.y + robot_height) / grid_cell_height;
-    
-    int grid_bottom_right_x = (robot.x + robot_width) / grid_cell_width;
-    int grid_bottom_right_y = grid_bottom_left_y;
-
-    // Check multiple points along the edges of the robot's bounding box
-    for (int x = grid_top_left_x; x <= grid_top_right_x; ++x) {
-        // Check the top and bottom edges
-        if (grid.grid[x][grid_top_left_y] == 2 || grid.grid[x][grid_bottom_left_y] == 2) {
-            std::cout << "Collision detected at (" << x << ", " << grid_top_left_y << ") or (" << x << ", " << grid_bottom_left_y << ")" << std::endl;
-            return true;
-        }
-    }
-
-    for (int y = grid_top_left_y; y <= grid_bottom_left_y; ++y) {
-        // Check the left and right edges
-        if (grid.grid[grid_top_left_x][y] == 2 || grid.grid[grid_top_right_x][y] == 2) {
-            std::cout << "Collision detected at (" << grid_top_left_x << ", " << y << ") or (" << grid_top_right_x << ", " << y << ")" << std::endl;
-            return true;
-        }
-    }
-
-    // If no collision detected, return false
-    return false;
-}
-
-// Obstacle avoidance function (Task 2) with smaller step sizes
-void obstacle_avoidance(Object& robot, const Object& goal, grid_util& grid, bool moving_x) {
-    bool obstacle_cleared = false;
-    
-    // Move perpendicular to current movement direction until the robot clears the obstacle
-    while (is_collision(robot, grid)) {
-        // Move in smaller steps to avoid skipping over obstacles
-        int step_size = 1;
-
-        if (moving_x) {
-            // If moving in x, shift in y to clear the obstacle
-            robot.y += (goal.y > robot.y) ? step_size : -step_size;
-        } else {
-            // If moving in y, shift in x to clear the obstacle
-            robot.x += (goal.x > robot.x) ? step_size : -step_size;
-        }
-
-        // Update the robot's position vector for rendering
-        robot_pos.push_back({robot.x, robot.y});
-
-        // If no more collisions are detected, mark the obstacle as cleared
-        if (!is_collision(robot, grid)) {
-            obstacle_cleared = true;
-        }
-    }
-
-    // Ensure the robot has moved sufficiently away from the obstacle before recalculating the path
-    if (obstacle_cleared) {
-        std::cout << "Obstacle cleared! Recalculating path towards the goal." << std::endl;
-        robot_pos.push_back({robot.x, robot.y});  // Force update after obstacle clearance
-    }
-}
-
-// Task 3 movement logic (x direction first)
-void moveRobotTask3(Object& robot, const Object& goal) {
-    int target_x = goal.x;
-    int target_y = goal.y;
-    int dx = 0, dy = 0;
-
-    // Move in x direction first
-    if (robot.x < target_x) {
-        dx = 1;
-    } else if (robot.x > target_x) {
-        dx = -1;
+#endif
+
+#ifdef HEADLESS
+// Batch mode: lab2_headless [episodes] [threads] [seed] [policy] [collision] [late objects] [flow threads]. Prints one CSV line per episode, then a summary.
+// threads defaults to 0, meaning one worker per core. seed defaults to a random one, printed for reruns.
+// policy is astar (default), jps, dstar, flow or greedy; collision is box (default), circle or objects.
+// late objects (default 0) obstacles are dropped near the robot mid-run, one every late_drop_interval steps.
+// flow threads (default 1, 0 = all cores) build each flow field; episodes already run one per worker.
+// Built with -DINSTRUMENT, both modes write a profile summary (see instrument.h)
+int main(int argc, char const *argv[])
+{
+    int episodes = (argc > 1) ? std::atoi(argv[1]) : 1000;
+    int threads = (argc > 2) ? std::atoi(argv[2]) : 0;
+    uint64_t base_seed = (argc > 3) ? std::strtoull(argv[3], nullptr, 0) : random_generator::random_seed();
+    sim_options options {POLICY_ASTAR, COLLISION_BOX, 0, 1};
+    if (argc > 4 && !parse_policy(argv[4], options.policy)) {
+        std::cerr << "Unknown policy " << argv[4] << ", expected astar, jps, dstar, flow or greedy" << std::endl;
+        return 1;
     }
-    // If x is aligned, move in y direction
-    else if (robot.y > target_y) {
-        dy = -1;
-    } else if (robot.y < target_y) {
-        dy = 1;
+    if (argc > 5 && !parse_collision(argv[5], options.collision)) {
+        std::cerr << "Unknown collision model " << argv[5] << ", expected box, circle or objects" << std::endl;
+        return 1;
     }
-
-    // Move robot
-    robot.x += dx;
-    robot.y += dy;
-
-    // Update the robot's position after movement
-    robot_pos.push_back({robot.x, robot.y});
-}
-
-// Task 4 movement logic (y direction first)
-void moveRobotTask4(Object& robot, const Object& goal) {
-    int target_x = goal.x;
-    int target_y = goal.y;
-    int dx = 0, dy = 0;
-
-    // Move in y direction first
-    if (robot.y > target_y) {
-        dy = -1;
-    } else if (robot.y < target_y) {
-        dy = 1;
+    options.late_objects = (argc > 6) ? std::atoi(argv[6]) : 0;
+    options.flow_threads = (argc > 7) ? std::atoi(argv[7]) : 1;
+    int successes = 0, total_steps = 0, total_collisions = 0, total_spawn_failures = 0;
+
+    prof_begin_run();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<episode_result> results = run_episodes(episodes, threads, base_seed, options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "# base seed: " << base_seed << std::endl;
+    std::cout << "episode,seed,success,steps,collisions,spawn_failures,wall_ms" << std::endl;
+    for (int i = 0; i < episodes; i++) {
+        const episode_result& result = results[i];
+        successes += result.success;
+        total_steps += result.steps;
+        total_collisions += result.collisions;
+        total_spawn_failures += result.spawn_failures;
+        std::cout << i << "," << result.seed << "," << result.success << "," << result.steps << "," << result.collisions << "," << result.spawn_failures << "," << result.wall_ms << "\n";
     }
-    // If y is aligned, move in x direction
-    else if (robot.x < target_x) {
-        dx = 1;
-    } else if (robot.x > target_x) {
-        dx = -1;
-    }
-
-    // Move robot
-    robot.x += dx;
-    robot.y += dy;
 
-    // Update the robot's position after movement
-    robot_pos.push_back({robot.x, robot.y});
+    std::cout << "# episodes: " << episodes << ", successes: " << successes
+              << ", mean steps: " << (episodes ? (double)total_steps/episodes : 0.0)
+              << ", collisions: " << total_collisions << ", spawn failures: " << total_spawn_failures << std::endl;
+    std::cout << "# wall time: " << seconds << " s, " << (seconds > 0 ? episodes/seconds : 0.0) << " episodes/s" << std::endl;
+    prof_end_run();
+    return 0;
 }
-
+#else
+// Windowed mode: lab2 [seed] [trajectory file] [--overwrite]. Pass an episode seed from
+// lab2_headless to watch that exact map. With a trajectory file, a file already holding the run
+// of this seed and map size is streamed back from disk without simulating; a missing file gets
+// the simulated run saved to it. A trajectory of another run is only replaced with --overwrite,
+// and a file that is not a trajectory at all is never touched
 int main(int argc, char const *argv[])
 {
-    // Create robot, goal, and objects
-    Object robot = grid.create_object(grid, rand_gen, robot_tol, 2*radius, 2*radius, robot_y_min, height-radius, 1, "robot");
-    Object goal = grid.create_object(grid, rand_gen, goal_tol, goal_width, goal_height, 0, goal_y_max, 3, "goal");
-    std::vector<Object> objects = grid.create_objects(rand_gen, occupancy_tol, num_objects);
-
-    Object robot_init = robot;
-    Object goal_init = goal;
-
-    robot_pos.push_back({robot.x, robot.y});
-
-    std::cout << "Starting main loop" << std::endl;
-
-    int max_count = 0;
-
-    // Main loop using Task 3 logic and improved obstacle avoidance
-    while (true) {
-        // Move the robot using Task 3 logic (x direction first)
-        moveRobotTask3(robot, goal);
-        
-        // Check for collision after each movement
-        if (is_collision(robot, grid)) {
-            std::cout << "Collision detected! Avoiding obstacle." << std::endl;
-            obstacle_avoidance(robot, goal, grid, true);  // Pass the goal to obstacle_avoidance
-        }
-
-        // Add the robot's new position to robot_positions
-        robot_pos.push_back({robot.x, robot.y});
-
-        // Check if the robot has reached the goal
-        if (is_goal_detected(robot, goal)) {
-            succeed = true;
-            std::cout << "Success! Goal reached!" << std::endl;
-            break;
-        }
-
-        max_count++;
-        if (max_count >= 3600) {
-            std::cout << "=====1 minute reached with no solution=====" << std::endl;
-            break;
+    episode_context ctx;
+    if (argc > 1) {
+        ctx.rand_gen.seed(std::strtoull(argv[1], nullptr, 0));
+    }
+    std::cout << "Seed: " << ctx.rand_gen.seed() << std::endl;
+    prof_begin_run();
+
+    if (argc > 2) {
+        std::string filename = argv[2];
+        const bool overwrite = (argc > 3) && std::string(argv[3]) == "--overwrite";
+        if (std::ifstream(filename).good()) {
+            if (!is_trajectory_file(filename)) {
+                std::cerr << "Error: " << filename << " exists and is not a trajectory file, leaving it alone" << std::endl;
+                prof_end_run();
+                return 1;
+            }
+            trajectory_file_source saved(filename);
+            const trajectory_header& run = saved.header();
+            if (saved.is_open() && run.seed == ctx.rand_gen.seed() && run.width == width && run.height == height) {
+                std::cout << "Replaying " << filename << std::endl;
+                render_window(saved, run.objects, run.robot_init, run.goal_init, run.width, run.height, run.succeed);
+                prof_end_run();
+                return 0;
+            }
+            if (!overwrite) {
+                if (saved.is_open()) {
+                    std::cerr << "Error: " << filename << " holds seed " << run.seed << " on a " << run.width << "x" << run.height
+                              << " map; pass --overwrite to replace it" << std::endl;
+                }
+                else {
+                    std::cerr << "Error: " << filename << " is a damaged trajectory; pass --overwrite to replace it" << std::endl;
+                }
+                prof_end_run();
+                return 1;
+            }
+            std::cout << "Overwriting " << filename << std::endl;
         }
-
-        if (max_count % 100 == 0) {
-            std::cout << "Iteration " << max_count << ": Robot at (" << robot.x << ", " << robot.y << ")" << std::endl;
+        run_episode(ctx);
+        const trajectory_header run {ctx.rand_gen.seed(), width, height, ctx.robot_init, ctx.goal_init, ctx.succeed, ctx.objects};
+        if (!write_trajectory(filename, run, ctx.robot_pos)) {
+            prof_end_run();
+            return 1;
         }
+        trajectory_file_source source(filename);
+        render_window(source, ctx.objects, ctx.robot_init, ctx.goal_init, width, height, ctx.succeed);
+        prof_end_run();
+        return 0;
     }
 
     // Render and complete
-    render_window(robot_pos, objects, robot_init, goal_init, width, height, succeed);
+    run_episode(ctx);
+    render_window(ctx.robot_pos, ctx.objects, ctx.robot_init, ctx.goal_init, width, height, ctx.succeed);
+    prof_end_run();
 
     return 0;
 }
+#endif
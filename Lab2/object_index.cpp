@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cmath>
+#include "object_index.h"
+
+void object_index::build(const std::vector<Object>& objects) {
+    levels.clear();
+    order.clear();
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (objects[i].width > 0 || objects[i].height > 0) {
+            order.push_back((int)i);
+        }
+    }
+    const int n = (int)order.size();
+    if (n == 0) {
+        return;
+    }
+
+    // Sort-Tile-Recursive: slices of slice_size rectangles by centre x, then centre y within each
+    const int leaves = (n + INDEX_NODE_SIZE - 1)/INDEX_NODE_SIZE;
+    const int slices = (int)std::ceil(std::sqrt((double)leaves));
+    const int slice_size = slices*INDEX_NODE_SIZE;
+    auto centre_x = [&](int i) { return 2*objects[i].x + objects[i].width; };
+    auto centre_y = [&](int i) { return 2*objects[i].y + objects[i].height; };
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return centre_x(a) < centre_x(b); });
+    for (int s = 0; s < n; s += slice_size) {
+        std::sort(order.begin() + s, order.begin() + std::min(n, s + slice_size),
+                  [&](int a, int b) { return centre_y(a) < centre_y(b); });
+    }
+
+    levels.emplace_back();
+    levels[0].reserve(n);
+    for (int i : order) {
+        const Object& o = objects[i];
+        levels[0].push_back(box{o.x, o.y, o.x + o.width, o.y + o.height});
+    }
+    while (levels.back().size() > 1) {
+        const std::vector<box>& below = levels.back();
+        std::vector<box> above((below.size() + INDEX_NODE_SIZE - 1)/INDEX_NODE_SIZE);
+        for (size_t i = 0; i < above.size(); i++) {
+            box b = below[i*INDEX_NODE_SIZE];
+            for (size_t c = i*INDEX_NODE_SIZE + 1; c < std::min(below.size(), (i+1)*INDEX_NODE_SIZE); c++) {
+                b.x0 = std::min(b.x0, below[c].x0);
+                b.y0 = std::min(b.y0, below[c].y0);
+                b.x1 = std::max(b.x1, below[c].x1);
+                b.y1 = std::max(b.y1, below[c].y1);
+            }
+            above[i] = b;
+        }
+        levels.push_back(std::move(above));
+    }
+}
+
+bool object_index::node_hits_box(int level, int i, int x0, int y0, int x1, int y1) const {
+    if (!overlaps(levels[level][i], x0, y0, x1, y1)) {
+        return false;
+    }
+    if (level == 0) {
+        return true;
+    }
+    const int end = std::min((int)levels[level-1].size(), (i+1)*INDEX_NODE_SIZE);
+    for (int c = i*INDEX_NODE_SIZE; c < end; c++) {
+        if (node_hits_box(level-1, c, x0, y0, x1, y1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool object_index::box_hits(int x0, int y0, int x1, int y1) const {
+    return !levels.empty() && node_hits_box((int)levels.size()-1, 0, x0, y0, x1, y1);
+}
@@ -0,0 +1,41 @@
+// Static spatial index over the obstacle rectangles create_objects returns, so collision and
+// overlap queries run against the exact geometry instead of the rasterized grid. Memory grows
+// with the number of obstacles, not with the map area.
+// An Object covers the inclusive cells [x, x+width] x [y, y+height], the same cells occupy_grid
+// writes, so answers line up with the grid's box checks
+#ifndef OBJECT_INDEX
+#define OBJECT_INDEX
+
+#include <cstdint>
+#include <vector>
+#include "utils.h"
+
+// Children per R-tree node
+const int INDEX_NODE_SIZE = 8;
+
+// Packed R-tree bulk-loaded with Sort-Tile-Recursive at the leaves: rectangles are sorted into
+// vertical slices by centre x, each slice by centre y, and packed INDEX_NODE_SIZE to a leaf. Upper
+// levels are not re-sorted; each node bounds the next INDEX_NODE_SIZE consecutive nodes of the level
+// below, so children are found by index alone. Rebuild after the obstacle list changes
+class object_index {
+    struct box {
+        int x0, y0, x1, y1;                 // inclusive
+    };
+    //levels[0] holds the rectangles in packed order, levels[k][i] bounds
+    //levels[k-1][i*INDEX_NODE_SIZE .. i*INDEX_NODE_SIZE + INDEX_NODE_SIZE-1]
+    std::vector<std::vector<box>> levels;
+    std::vector<int> order;                 // build scratch
+
+    static bool overlaps(const box& b, int x0, int y0, int x1, int y1) {
+        return b.x0 <= x1 && x0 <= b.x1 && b.y0 <= y1 && y0 <= b.y1;
+    }
+    bool node_hits_box(int, int, int, int, int, int) const;
+    public:
+        // Objects with zero width and height (spawns create_objects gave up on) are left out
+        void build(const std::vector<Object>&);
+        size_t size() const { return levels.empty() ? 0 : levels[0].size(); }
+        // Does any obstacle cell lie in the inclusive box [x0,x1] x [y0,y1]?
+        bool box_hits(int, int, int, int) const;
+};
+
+#endif
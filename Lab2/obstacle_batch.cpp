@@ -0,0 +1,152 @@
+#include <algorithm>
+#include "obstacle_batch.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Per-axis gaps are clamped here before squaring, so two squares still fit in an int32 lane
+const int32_t BATCH_GAP_CAP = 32767;
+
+// Drop the old padding, then refill the tail to a multiple of 16 lanes
+void obstacle_batch::pad() {
+    const size_t lanes = ((size_t)count + 15) & ~(size_t)15;
+    x.resize(count);
+    y.resize(count);
+    w.resize(count);
+    h.resize(count);
+    x.resize(lanes, BATCH_FAR);
+    y.resize(lanes, BATCH_FAR);
+    w.resize(lanes, 0);
+    h.resize(lanes, 0);
+}
+
+void obstacle_batch::assign(const std::vector<Object>& objects) {
+    x.clear();
+    y.clear();
+    w.clear();
+    h.clear();
+    count = 0;
+    for (const Object& o : objects) {
+        if (o.width > 0 || o.height > 0) {
+            x.push_back(o.x);
+            y.push_back(o.y);
+            w.push_back(o.width);
+            h.push_back(o.height);
+            count++;
+        }
+    }
+    pad();
+}
+
+void obstacle_batch::push_back(const Object& o) {
+    if (o.width <= 0 && o.height <= 0) {
+        return;
+    }
+    x.resize(count);
+    y.resize(count);
+    w.resize(count);
+    h.resize(count);
+    x.push_back(o.x);
+    y.push_back(o.y);
+    w.push_back(o.width);
+    h.push_back(o.height);
+    count++;
+    pad();
+}
+
+bool obstacle_batch::rect_hits(int x0, int y0, int x1, int y1) const {
+    int i = 0;
+#if defined(__AVX512F__)
+    const int lanes = (int)x.size();
+    // A lane misses when the obstacle lies wholly past one side of the query box
+    const __m512i qx0 = _mm512_set1_epi32(x0), qy0 = _mm512_set1_epi32(y0);
+    const __m512i qx1 = _mm512_set1_epi32(x1), qy1 = _mm512_set1_epi32(y1);
+    for (; i < lanes; i += 16) {
+        const __m512i ox = _mm512_loadu_si512(&x[i]), oy = _mm512_loadu_si512(&y[i]);
+        const __m512i ox1 = _mm512_add_epi32(ox, _mm512_loadu_si512(&w[i]));
+        const __m512i oy1 = _mm512_add_epi32(oy, _mm512_loadu_si512(&h[i]));
+        __mmask16 hit = _mm512_cmple_epi32_mask(ox, qx1) & _mm512_cmple_epi32_mask(qx0, ox1) &
+                        _mm512_cmple_epi32_mask(oy, qy1) & _mm512_cmple_epi32_mask(qy0, oy1);
+        if (hit) {
+            return true;
+        }
+    }
+#elif defined(__AVX2__)
+    const int lanes = (int)x.size();
+    const __m256i qx0 = _mm256_set1_epi32(x0), qy0 = _mm256_set1_epi32(y0);
+    const __m256i qx1 = _mm256_set1_epi32(x1), qy1 = _mm256_set1_epi32(y1);
+    for (; i < lanes; i += 8) {
+        const __m256i ox = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x[i]));
+        const __m256i oy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&y[i]));
+        const __m256i ox1 = _mm256_add_epi32(ox, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&w[i])));
+        const __m256i oy1 = _mm256_add_epi32(oy, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&h[i])));
+        __m256i miss = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(ox, qx1), _mm256_cmpgt_epi32(qx0, ox1)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(oy, qy1), _mm256_cmpgt_epi32(qy0, oy1)));
+        if (_mm256_movemask_epi8(miss) != -1) {
+            return true;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (x[i] <= x1 && x0 <= x[i] + w[i] && y[i] <= y1 && y0 <= y[i] + h[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool obstacle_batch::circle_hits(int cx, int cy, int r) const {
+    const int32_t r2 = r*r;
+    int i = 0;
+#if defined(__AVX512F__)
+    const int lanes = (int)x.size();
+    // Gap along each axis is max(x - cx, cx - (x+w), 0), zero when cx lies within the span
+    const __m512i qx = _mm512_set1_epi32(cx), qy = _mm512_set1_epi32(cy);
+    const __m512i zero = _mm512_setzero_si512(), cap = _mm512_set1_epi32(BATCH_GAP_CAP);
+    const __m512i limit = _mm512_set1_epi32(r2);
+    // Zero-masked min/max over every lane: the unmasked forms pass an undefined vector through
+    // and GCC 12 warns about it as maybe-uninitialized. Same instructions either way
+    const __mmask16 all = 0xFFFF;
+    for (; i < lanes; i += 16) {
+        const __m512i ox = _mm512_loadu_si512(&x[i]), oy = _mm512_loadu_si512(&y[i]);
+        const __m512i ox1 = _mm512_add_epi32(ox, _mm512_loadu_si512(&w[i]));
+        const __m512i oy1 = _mm512_add_epi32(oy, _mm512_loadu_si512(&h[i]));
+        __m512i dx = _mm512_maskz_max_epi32(all, _mm512_maskz_max_epi32(all, _mm512_sub_epi32(ox, qx), _mm512_sub_epi32(qx, ox1)), zero);
+        __m512i dy = _mm512_maskz_max_epi32(all, _mm512_maskz_max_epi32(all, _mm512_sub_epi32(oy, qy), _mm512_sub_epi32(qy, oy1)), zero);
+        dx = _mm512_maskz_min_epi32(all, dx, cap);
+        dy = _mm512_maskz_min_epi32(all, dy, cap);
+        const __m512i d2 = _mm512_add_epi32(_mm512_mullo_epi32(dx, dx), _mm512_mullo_epi32(dy, dy));
+        if (_mm512_cmplt_epi32_mask(d2, limit)) {
+            return true;
+        }
+    }
+#elif defined(__AVX2__)
+    const int lanes = (int)x.size();
+    const __m256i qx = _mm256_set1_epi32(cx), qy = _mm256_set1_epi32(cy);
+    const __m256i zero = _mm256_setzero_si256(), cap = _mm256_set1_epi32(BATCH_GAP_CAP);
+    const __m256i limit = _mm256_set1_epi32(r2);
+    for (; i < lanes; i += 8) {
+        const __m256i ox = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&x[i]));
+        const __m256i oy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&y[i]));
+        const __m256i ox1 = _mm256_add_epi32(ox, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&w[i])));
+        const __m256i oy1 = _mm256_add_epi32(oy, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&h[i])));
+        __m256i dx = _mm256_max_epi32(_mm256_max_epi32(_mm256_sub_epi32(ox, qx), _mm256_sub_epi32(qx, ox1)), zero);
+        __m256i dy = _mm256_max_epi32(_mm256_max_epi32(_mm256_sub_epi32(oy, qy), _mm256_sub_epi32(qy, oy1)), zero);
+        dx = _mm256_min_epi32(dx, cap);
+        dy = _mm256_min_epi32(dy, cap);
+        const __m256i d2 = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(limit, d2))) {
+            return true;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        const int64_t dx = std::max({x[i] - cx, cx - (x[i] + w[i]), 0});
+        const int64_t dy = std::max({y[i] - cy, cy - (y[i] + h[i]), 0});
+        if (dx*dx + dy*dy < (int64_t)r2) {
+            return true;
+        }
+    }
+    return false;
+}
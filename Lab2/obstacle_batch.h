@@ -0,0 +1,35 @@
+// Obstacle rectangles as a structure of arrays, scanned brute force with SIMD. For up to a few
+// thousand obstacles one vectorized pass over x[], y[], w[], h[] beats walking a tree: AVX-512
+// tests 16 rectangles per compare, AVX2 8, and builds without either take the scalar loop.
+// Same cell convention as object_index: an Object covers [x, x+width] x [y, y+height] inclusive
+#ifndef OBSTACLE_BATCH
+#define OBSTACLE_BATCH
+
+#include <cstdint>
+#include <vector>
+#include "utils.h"
+
+// Above this many obstacles the R-tree in object_index answers collision queries instead
+const int BATCH_SCAN_LIMIT = 4096;
+// Corner of the padding rectangles; queries are expected well inside +-BATCH_FAR
+const int32_t BATCH_FAR = 1 << 30;
+
+class obstacle_batch {
+    //Padded to a multiple of 16 lanes with empty rectangles at BATCH_FAR, far off any map
+    std::vector<int32_t> x, y, w, h;
+    int count;
+    void pad();
+    public:
+        obstacle_batch(): count(0) {}
+        // Objects with zero width and height (spawns create_objects gave up on) are left out
+        void assign(const std::vector<Object>&);
+        void push_back(const Object&);
+        int size() const { return count; }
+        // Does any obstacle cell lie in the inclusive box [x0,x1] x [y0,y1]?
+        bool rect_hits(int, int, int, int) const;
+        // Does any obstacle cell lie strictly closer than r to (cx, cy)? Same test as
+        // distance_field::circle_hits_obstacle; r must stay below 32768
+        bool circle_hits(int, int, int) const;
+};
+
+#endif
@@ -0,0 +1,900 @@
+#include <algorithm>
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "planner.h"
+
+// Per-cell search states, valid only for cells stamped with the current generation
+enum cell_state : uint8_t {
+    STATE_NEW = 0,
+    STATE_OPEN = 1,
+    STATE_CLOSED = 2,
+    STATE_BLOCKED = 3
+};
+
+static const int dir_x[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int dir_y[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+// Robot corner (x, y) is off the map, or its footprint [x, x+robot_w] x [y, y+robot_h] touches an
+// obstacle. The part of the footprint hanging past the map edge is ignored, as in is_collision
+bool position_blocked(const grid_util& grid, int x, int y, int robot_w, int robot_h) {
+    if (x < 0 || y < 0 || x >= grid.width() || y >= grid.height()) {
+        return true;
+    }
+    if (grid.has_footprint(robot_w, robot_h)) {
+        return grid.cspace_at(x, y);
+    }
+    return grid.box_has_obstacle(x, y, x + robot_w, y + robot_h);
+}
+
+// Octile distance from (x, y) to the nearest position of the region; exact on an open grid
+int octile_to_region(int x, int y, const goal_region& goal) {
+    int dx = (x < goal.x0) ? goal.x0 - x : (x > goal.x1) ? x - goal.x1 : 0;
+    int dy = (y < goal.y0) ? goal.y0 - y : (y > goal.y1) ? y - goal.y1 : 0;
+    int lo = std::min(dx, dy), hi = std::max(dx, dy);
+    return DIAGONAL_COST*lo + STRAIGHT_COST*(hi - lo);
+}
+
+int path_cost(const std::vector<grid_point>& path) {
+    int cost = 0;
+    for (size_t i = 1; i < path.size(); i++) {
+        const bool diagonal = path[i].x != path[i - 1].x && path[i].y != path[i - 1].y;
+        cost += diagonal ? DIAGONAL_COST : STRAIGHT_COST;
+    }
+    return cost;
+}
+
+// Start a query on a w x h grid, resizing the arrays only when the grid size changed
+void search_pool::begin(int w, int h) {
+    if (w != width || h != height) {
+        const size_t cells = (size_t)w*h;
+        width = w;
+        height = h;
+        generation = 0;
+        stamp.assign(cells, 0);
+        state.assign(cells, STATE_NEW);
+        g_score.assign(cells, 0);
+        parent.assign(cells, -1);
+        open.assign(cells);
+    }
+    if (++generation == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+    }
+    open.heap.clear();
+}
+
+// Plan from start to any position in goal for a robot_w x robot_h footprint. On success the
+// path holds every position from start to the goal inclusive, one 8-connected step apart
+bool astar_planner::plan(const grid_util& grid, grid_point start, const goal_region& goal,
+                         int robot_w, int robot_h, std::vector<grid_point>& path)
+{
+    const int width = grid.width(), height = grid.height();
+    pool.begin(width, height);
+    path.clear();
+    expanded = 0;
+
+    // Stamp a cell into this query on first touch, classifying it as NEW or BLOCKED
+    std::vector<uint8_t>& state = pool.state;
+    std::vector<int32_t>& g_score = pool.g_score;
+    std::vector<int32_t>& parent = pool.parent;
+    auto touch = [&](int x, int y) -> uint8_t {
+        const size_t i = (size_t)x*height + y;
+        if (pool.fresh(i)) {
+            state[i] = position_blocked(grid, x, y, robot_w, robot_h) ? STATE_BLOCKED : STATE_NEW;
+        }
+        return state[i];
+    };
+
+    if (start.x < 0 || start.y < 0 || start.x >= width || start.y >= height ||
+        touch(start.x, start.y) == STATE_BLOCKED) {
+        return false;
+    }
+    const int32_t start_cell = start.x*height + start.y;
+    g_score[start_cell] = 0;
+    pool.open.key[start_cell] = astar_key{octile_to_region(start.x, start.y, goal), 0};
+    parent[start_cell] = -1;
+    state[start_cell] = STATE_OPEN;
+    pool.open.push(start_cell);
+
+    while (!pool.open.empty()) {
+        const int32_t cur = pool.open.pop();
+        state[cur] = STATE_CLOSED;
+        expanded++;
+        const int cx = cur / height, cy = cur % height;
+
+        if (cx >= goal.x0 && cx <= goal.x1 && cy >= goal.y0 && cy <= goal.y1) {
+            for (int32_t c = cur; c != -1; c = parent[c]) {
+                path.push_back(grid_point{c / height, c % height});
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+
+        for (int d = 0; d < 8; d++) {
+            const int nx = cx + dir_x[d], ny = cy + dir_y[d];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                continue;
+            }
+            const bool diagonal = (d >= 4);
+            if (diagonal && (touch(nx, cy) == STATE_BLOCKED || touch(cx, ny) == STATE_BLOCKED)) {
+                continue;
+            }
+            const uint8_t s = touch(nx, ny);
+            if (s == STATE_BLOCKED || s == STATE_CLOSED) {
+                continue;
+            }
+            const int32_t n = nx*height + ny;
+            const int32_t g = g_score[cur] + (diagonal ? DIAGONAL_COST : STRAIGHT_COST);
+            if (s == STATE_NEW) {
+                g_score[n] = g;
+                pool.open.key[n] = astar_key{g + octile_to_region(nx, ny, goal), g};
+                parent[n] = cur;
+                state[n] = STATE_OPEN;
+                pool.open.push(n);
+            }
+            else if (g < g_score[n]) {
+                pool.open.key[n] = astar_key{pool.open.key[n].f + g - g_score[n], g};
+                g_score[n] = g;
+                parent[n] = cur;
+                pool.open.up(pool.open.pos[n]);
+            }
+        }
+    }
+    return false;
+}
+
+// Build the blocked-position bitsets: a position is blocked when the footprint
+// [x, x+robot_w] x [y, y+robot_h] covers an obstacle. Copied from the grid's C-space layer when it
+// tracks this footprint; otherwise columns are OR-ed across the footprint width and dilated along y
+void jps_planner::prepare(const grid_util& grid, int w, int h) {
+    width = grid.width();
+    height = grid.height();
+    robot_w = w;
+    robot_h = h;
+    col_words = grid.obstacle_row_words();
+    row_words = (width + 63) / 64;
+    col_bits.assign((size_t)width*col_words, 0);
+    row_bits.assign((size_t)height*row_words, 0);
+
+    const bool cspace = grid.has_footprint(robot_w, robot_h);
+    for (int x = 0; x < width; x++) {
+        uint64_t* col = &col_bits[(size_t)x*col_words];
+        if (cspace) {
+            std::copy(grid.cspace_row(x), grid.cspace_row(x) + col_words, col);
+        }
+        else {
+            for (int k = 0; k <= robot_w && x + k < width; k++) {
+                const uint64_t* src = grid.obstacle_row(x + k);
+                for (int i = 0; i < col_words; i++) {
+                    col[i] |= src[i];
+                }
+            }
+            dilate_bits_down(col, col_words, robot_h + 1);
+        }
+        // Padding past the map edge reads as blocked so scans stop there
+        if (height & 63) {
+            col[col_words - 1] |= ~0ULL << (height & 63);
+        }
+        // Transpose into the row-wise copy
+        for (int i = 0; i < col_words; i++) {
+            uint64_t bits = col[i];
+            while (bits) {
+                const int y = i*64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (y < height) {
+                    row_bits[(size_t)y*row_words + (x >> 6)] |= 1ULL << (x & 63);
+                }
+            }
+        }
+    }
+    if (width & 63) {
+        for (int y = 0; y < height; y++) {
+            row_bits[(size_t)y*row_words + row_words - 1] |= ~0ULL << (width & 63);
+        }
+    }
+}
+
+// Bits lo..hi of word w, clipped to the word; empty when the range misses it
+static inline uint64_t range_mask(int w, int lo, int hi) {
+    lo = std::max(lo, w*64);
+    hi = std::min(hi, w*64 + 63);
+    if (lo > hi) {
+        return 0;
+    }
+    return (~0ULL >> (63 - (hi - w*64))) & (~0ULL << (lo - w*64));
+}
+
+// Scan one line of blocked bits from `start` in direction dir (+1/-1), a word at a time.
+// side_a/side_b are the neighbouring lines (nullptr off the map). Returns the first position
+// with a forced neighbour (a side cell that opens up right after being blocked) or inside
+// [goal_lo, goal_hi], or -1 if a blocked position comes first
+static int scan_line(const uint64_t* line, const uint64_t* side_a, const uint64_t* side_b,
+                     int words, int start, int dir, int goal_lo, int goal_hi)
+{
+    const uint64_t* sides[2] = {side_a, side_b};
+    int w = start >> 6;
+    if (dir > 0) {
+        uint64_t mask = ~0ULL << (start & 63);
+        for (; w < words; w++, mask = ~0ULL) {
+            uint64_t forced = 0;
+            for (const uint64_t* side : sides) {
+                if (side) {
+                    const uint64_t carry = (w > 0) ? side[w - 1] >> 63 : 1;
+                    forced |= ~side[w] & ((side[w] << 1) | carry);
+                }
+            }
+            const uint64_t blocked = line[w];
+            const uint64_t hits = (blocked | forced | range_mask(w, goal_lo, goal_hi)) & mask;
+            if (hits) {
+                const int p = __builtin_ctzll(hits);
+                return ((blocked >> p) & 1) ? -1 : w*64 + p;
+            }
+        }
+    }
+    else {
+        uint64_t mask = ~0ULL >> (63 - (start & 63));
+        for (; w >= 0; w--, mask = ~0ULL) {
+            uint64_t forced = 0;
+            for (const uint64_t* side : sides) {
+                if (side) {
+                    const uint64_t carry = (w + 1 < words) ? side[w + 1] & 1 : 1;
+                    forced |= ~side[w] & ((side[w] >> 1) | (carry << 63));
+                }
+            }
+            const uint64_t blocked = line[w];
+            const uint64_t hits = (blocked | forced | range_mask(w, goal_lo, goal_hi)) & mask;
+            if (hits) {
+                const int p = 63 - __builtin_clzll(hits);
+                return ((blocked >> p) & 1) ? -1 : w*64 + p;
+            }
+        }
+    }
+    return -1;
+}
+
+// Straight jump from (x, y) along (dx, dy), one of which is zero. Vertical jumps scan the
+// column-wise bits, horizontal jumps the row-wise copy
+bool jps_planner::jump_straight(int x, int y, int dx, int dy, const goal_region& goal, int& jx, int& jy) const {
+    if (dx == 0) {
+        const int start = y + dy;
+        if (x < 0 || x >= width || start < 0 || start >= height) {
+            return false;
+        }
+        const bool goal_col = (x >= goal.x0 && x <= goal.x1);
+        const int pos = scan_line(&col_bits[(size_t)x*col_words],
+                                  (x > 0) ? &col_bits[(size_t)(x - 1)*col_words] : nullptr,
+                                  (x + 1 < width) ? &col_bits[(size_t)(x + 1)*col_words] : nullptr,
+                                  col_words, start, dy, goal_col ? goal.y0 : 1, goal_col ? goal.y1 : 0);
+        if (pos < 0) {
+            return false;
+        }
+        jx = x;
+        jy = pos;
+        return true;
+    }
+    const int start = x + dx;
+    if (y < 0 || y >= height || start < 0 || start >= width) {
+        return false;
+    }
+    const bool goal_row = (y >= goal.y0 && y <= goal.y1);
+    const int pos = scan_line(&row_bits[(size_t)y*row_words],
+                              (y > 0) ? &row_bits[(size_t)(y - 1)*row_words] : nullptr,
+                              (y + 1 < height) ? &row_bits[(size_t)(y + 1)*row_words] : nullptr,
+                              row_words, start, dx, goal_row ? goal.x0 : 1, goal_row ? goal.x1 : 0);
+    if (pos < 0) {
+        return false;
+    }
+    jx = pos;
+    jy = y;
+    return true;
+}
+
+// Jump from (x, y) in direction (dx, dy). Diagonal jumps step one cell at a time and stop where
+// either straight component finds a jump point; without corner cutting they need no forced checks
+bool jps_planner::jump(int x, int y, int dx, int dy, const goal_region& goal, int& jx, int& jy) const {
+    if (dx == 0 || dy == 0) {
+        return jump_straight(x, y, dx, dy, goal, jx, jy);
+    }
+    int tx, ty;
+    while (true) {
+        if (blocked(x + dx, y) || blocked(x, y + dy) || blocked(x + dx, y + dy)) {
+            return false;
+        }
+        x += dx;
+        y += dy;
+        if ((x >= goal.x0 && x <= goal.x1 && y >= goal.y0 && y <= goal.y1) ||
+            jump_straight(x, y, dx, 0, goal, tx, ty) || jump_straight(x, y, 0, dy, goal, tx, ty)) {
+            jx = x;
+            jy = y;
+            return true;
+        }
+    }
+}
+
+// Plan over the positions prepared by prepare(). Search nodes are jump points only; the returned
+// path is filled back in so it lists every position, one 8-connected step apart, like A*
+bool jps_planner::plan(grid_point start, const goal_region& goal, std::vector<grid_point>& path)
+{
+    path.clear();
+    expanded = 0;
+    if (width == 0 || blocked(start.x, start.y)) {
+        return false;
+    }
+    pool.begin(width, height);
+
+    std::vector<uint8_t>& state = pool.state;
+    std::vector<int32_t>& g_score = pool.g_score;
+    std::vector<int32_t>& parent = pool.parent;
+
+    const int32_t start_cell = start.x*height + start.y;
+    pool.fresh(start_cell);
+    g_score[start_cell] = 0;
+    pool.open.key[start_cell] = astar_key{octile_to_region(start.x, start.y, goal), 0};
+    parent[start_cell] = -1;
+    state[start_cell] = STATE_OPEN;
+    pool.open.push(start_cell);
+
+    int dirs[8][2];
+    while (!pool.open.empty()) {
+        const int32_t cur = pool.open.pop();
+        state[cur] = STATE_CLOSED;
+        expanded++;
+        const int cx = cur / height, cy = cur % height;
+
+        if (cx >= goal.x0 && cx <= goal.x1 && cy >= goal.y0 && cy <= goal.y1) {
+            for (int32_t c = cur; c != -1; c = parent[c]) {
+                int x = c / height, y = c % height;
+                const int32_t p = parent[c];
+                const int px = (p == -1) ? x : p / height, py = (p == -1) ? y : p % height;
+                // Fill in the straight or diagonal segment back to the previous jump point
+                while (x != px || y != py) {
+                    path.push_back(grid_point{x, y});
+                    x += (px > x) - (px < x);
+                    y += (py > y) - (py < y);
+                }
+                if (p == -1) {
+                    path.push_back(grid_point{x, y});
+                }
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+
+        // Pruned directions: natural successors plus the sideways ones that may be forced
+        int n_dirs = 0;
+        if (parent[cur] == -1) {
+            for (int d = 0; d < 8; d++) {
+                dirs[n_dirs][0] = dir_x[d];
+                dirs[n_dirs++][1] = dir_y[d];
+            }
+        }
+        else {
+            const int px = parent[cur] / height, py = parent[cur] % height;
+            const int dx = (cx > px) - (cx < px), dy = (cy > py) - (cy < py);
+            if (dx != 0 && dy != 0) {
+                const int d3[3][2] = {{dx, 0}, {0, dy}, {dx, dy}};
+                for (const auto& d : d3) {
+                    dirs[n_dirs][0] = d[0];
+                    dirs[n_dirs++][1] = d[1];
+                }
+            }
+            else {
+                const int sx = (dx != 0) ? 0 : 1, sy = (dx != 0) ? 1 : 0;
+                const int d5[5][2] = {{dx, dy}, {dx + sx, dy + sy}, {dx - sx, dy - sy}, {sx, sy}, {-sx, -sy}};
+                for (const auto& d : d5) {
+                    dirs[n_dirs][0] = d[0];
+                    dirs[n_dirs++][1] = d[1];
+                }
+            }
+        }
+
+        for (int d = 0; d < n_dirs; d++) {
+            int jx, jy;
+            if (!jump(cx, cy, dirs[d][0], dirs[d][1], goal, jx, jy)) {
+                continue;
+            }
+            const int32_t n = jx*height + jy;
+            if (pool.fresh(n)) {
+                state[n] = STATE_NEW;
+            }
+            if (state[n] == STATE_CLOSED) {
+                continue;
+            }
+            const int steps = std::max(std::abs(jx - cx), std::abs(jy - cy));
+            const int32_t g = g_score[cur] + steps*((dirs[d][0] != 0 && dirs[d][1] != 0) ? DIAGONAL_COST : STRAIGHT_COST);
+            if (state[n] == STATE_NEW) {
+                g_score[n] = g;
+                pool.open.key[n] = astar_key{g + octile_to_region(jx, jy, goal), g};
+                parent[n] = cur;
+                state[n] = STATE_OPEN;
+                pool.open.push(n);
+            }
+            else if (g < g_score[n]) {
+                pool.open.key[n] = astar_key{pool.open.key[n].f + g - g_score[n], g};
+                g_score[n] = g;
+                parent[n] = cur;
+                pool.open.up(pool.open.pos[n]);
+            }
+        }
+    }
+    return false;
+}
+
+static const int32_t DSTAR_INF = INT32_MAX / 4;
+
+// Octile distance between two positions, the D* Lite heuristic
+static int octile(int x0, int y0, int x1, int y1) {
+    int dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+    int lo = std::min(dx, dy), hi = std::max(dx, dy);
+    return DIAGONAL_COST*lo + STRAIGHT_COST*(hi - lo);
+}
+
+void dstar_planner::touch(int32_t i) {
+    if (stamp[i] != generation) {
+        stamp[i] = generation;
+        g[i] = DSTAR_INF;
+        rhs[i] = DSTAR_INF;
+        open.pos[i] = -1;
+    }
+}
+
+int32_t dstar_planner::g_of(int32_t i) const {
+    return (stamp[i] == generation) ? g[i] : DSTAR_INF;
+}
+
+// Cost of the move from (x, y) along direction d, DSTAR_INF if either end is blocked or a
+// diagonal would cut a corner. Moves are symmetric, so this also serves the backward search
+int32_t dstar_planner::step_cost(int x, int y, int d) const {
+    const int nx = x + dir_x[d], ny = y + dir_y[d];
+    if (blocked(x, y) || blocked(nx, ny)) {
+        return DSTAR_INF;
+    }
+    if (d >= 4) {
+        if (blocked(nx, y) || blocked(x, ny)) {
+            return DSTAR_INF;
+        }
+        return DIAGONAL_COST;
+    }
+    return STRAIGHT_COST;
+}
+
+dstar_planner::key dstar_planner::calc_key(int32_t i) const {
+    const int32_t m = std::min(g_of(i), rhs[i]);
+    return key{(int64_t)m + octile(start_pos.x, start_pos.y, i / height, i % height) + km, m};
+}
+
+// Queue the cell with a fresh key if it is inconsistent (g != rhs), otherwise drop it
+void dstar_planner::settle(int32_t i) {
+    if (open.pos[i] >= 0) {
+        open.remove(i);
+    }
+    if (g[i] != rhs[i]) {
+        open.key[i] = calc_key(i);
+        open.push(i);
+    }
+}
+
+// Recompute rhs of (x, y) from its neighbours' g values
+void dstar_planner::update_vertex(int x, int y) {
+    const int32_t i = x*height + y;
+    touch(i);
+    if (blocked(x, y)) {
+        rhs[i] = DSTAR_INF;
+    }
+    else if (in_goal(x, y)) {
+        rhs[i] = 0;
+    }
+    else {
+        int32_t best = DSTAR_INF;
+        for (int d = 0; d < 8; d++) {
+            const int32_t c = step_cost(x, y, d);
+            if (c < DSTAR_INF) {
+                best = std::min(best, c + g_of((x + dir_x[d])*height + y + dir_y[d]));
+            }
+        }
+        rhs[i] = std::min(best, DSTAR_INF);
+    }
+    settle(i);
+}
+
+void dstar_planner::compute_shortest_path() {
+    const int32_t s = start_pos.x*height + start_pos.y;
+    touch(s);
+    while (!open.empty()) {
+        const int32_t u = open.top();
+        if (!(open.key[u] < calc_key(s)) && rhs[s] == g[s]) {
+            break;
+        }
+        expanded++;
+        const int ux = u / height, uy = u % height;
+        const key k = calc_key(u);
+        if (open.key[u] < k) {
+            // Key went stale as the robot moved; requeue at its real priority
+            open.key[u] = k;
+            open.down(0);
+        }
+        else if (g[u] > rhs[u]) {
+            // Overconsistent: settle g and lower the neighbours' rhs through u
+            g[u] = rhs[u];
+            open.remove(u);
+            for (int d = 0; d < 8; d++) {
+                const int nx = ux + dir_x[d], ny = uy + dir_y[d];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height || in_goal(nx, ny)) {
+                    continue;
+                }
+                const int32_t c = step_cost(ux, uy, d);
+                if (c < DSTAR_INF) {
+                    const int32_t n = nx*height + ny;
+                    touch(n);
+                    if (c + g[u] < rhs[n]) {
+                        rhs[n] = c + g[u];
+                        settle(n);
+                    }
+                }
+            }
+        }
+        else {
+            // Underconsistent: raise g and re-derive u and every neighbour that may have used it
+            g[u] = DSTAR_INF;
+            update_vertex(ux, uy);
+            for (int d = 0; d < 8; d++) {
+                const int nx = ux + dir_x[d], ny = uy + dir_y[d];
+                if (nx >= 0 && ny >= 0 && nx < width && ny < height) {
+                    update_vertex(nx, ny);
+                }
+            }
+        }
+    }
+}
+
+// Start a run: seed every free goal position with rhs = 0 and search back to the robot
+bool dstar_planner::start(const grid_util& map, grid_point from, const goal_region& region, int w, int h) {
+    grid = &map;
+    goal = region;
+    robot_w = w;
+    robot_h = h;
+    if (map.width() != width || map.height() != height) {
+        width = map.width();
+        height = map.height();
+        const size_t cells = (size_t)width*height;
+        generation = 0;
+        stamp.assign(cells, 0);
+        g.assign(cells, DSTAR_INF);
+        rhs.assign(cells, DSTAR_INF);
+        open.assign(cells);
+    }
+    if (++generation == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+    }
+    open.heap.clear();
+    km = 0;
+    expanded = 0;
+    start_pos = from;
+    last_pos = from;
+    if (from.x < 0 || from.y < 0 || from.x >= width || from.y >= height) {
+        return false;
+    }
+    for (int x = std::max(0, goal.x0); x <= std::min(width - 1, goal.x1); x++) {
+        for (int y = std::max(0, goal.y0); y <= std::min(height - 1, goal.y1); y++) {
+            if (!blocked(x, y)) {
+                const int32_t i = x*height + y;
+                touch(i);
+                rhs[i] = 0;
+                settle(i);
+            }
+        }
+    }
+    compute_shortest_path();
+    return g_of(start_pos.x*height + start_pos.y) < DSTAR_INF;
+}
+
+// Positions whose footprint covers a changed cell may have flipped between free and blocked;
+// one more ring around them covers the moves into them and the diagonals passing their corners
+void dstar_planner::notify_changed(int x0, int y0, int x1, int y1) {
+    if (!grid) {
+        return;
+    }
+    km += octile(last_pos.x, last_pos.y, start_pos.x, start_pos.y);
+    last_pos = start_pos;
+    const int px0 = std::max(0, x0 - robot_w - 1), py0 = std::max(0, y0 - robot_h - 1);
+    const int px1 = std::min(width - 1, x1 + 1), py1 = std::min(height - 1, y1 + 1);
+    for (int x = px0; x <= px1; x++) {
+        for (int y = py0; y <= py1; y++) {
+            update_vertex(x, y);
+        }
+    }
+}
+
+int32_t dstar_planner::path_cost() {
+    if (!grid) {
+        return -1;
+    }
+    compute_shortest_path();
+    const int32_t cost = g_of(start_pos.x*height + start_pos.y);
+    return (cost < DSTAR_INF) ? cost : -1;
+}
+
+bool dstar_planner::next_step(grid_point& next) {
+    if (!grid || in_goal(start_pos.x, start_pos.y)) {
+        return false;
+    }
+    compute_shortest_path();
+    int32_t best = DSTAR_INF;
+    int best_d = -1;
+    for (int d = 0; d < 8; d++) {
+        const int32_t c = step_cost(start_pos.x, start_pos.y, d);
+        if (c >= DSTAR_INF) {
+            continue;
+        }
+        const int32_t total = c + g_of((start_pos.x + dir_x[d])*height + start_pos.y + dir_y[d]);
+        if (total < best) {
+            best = total;
+            best_d = d;
+        }
+    }
+    if (best_d < 0) {
+        return false;
+    }
+    start_pos.x += dir_x[best_d];
+    start_pos.y += dir_y[best_d];
+    next = start_pos;
+    return true;
+}
+
+// Runs job(t) for t = 0..size()-1 as one phase, with the calling thread as worker 0. Workers
+// persist across phases, so a phase costs two condition-variable handoffs instead of thread starts
+class phase_pool {
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable start_cv, done_cv;
+    //The phase's job, type-erased without std::function so running one never allocates
+    void (*job)(const void*, int);
+    const void* job_arg;
+    uint64_t phase;
+    int running;
+    bool stopping;
+
+    void worker(int t) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                start_cv.wait(guard, [&] { return stopping || phase != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = phase;
+            }
+            job(job_arg, t);
+            std::lock_guard<std::mutex> guard(lock);
+            if (--running == 0) {
+                done_cv.notify_one();
+            }
+        }
+    }
+    public:
+        explicit phase_pool(int n): job(nullptr), job_arg(nullptr), phase(0), running(0), stopping(false) {
+            for (int t = 1; t < n; t++) {
+                threads.emplace_back(&phase_pool::worker, this, t);
+            }
+        }
+        ~phase_pool() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            start_cv.notify_all();
+            for (std::thread& t : threads) {
+                t.join();
+            }
+        }
+        int size() const { return (int)threads.size() + 1; }
+        template <typename F>
+        void run(const F& fn) {
+            auto call = [](const void* f, int t) { (*static_cast<const F*>(f))(t); };
+            if (threads.empty()) {
+                fn(0);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                job = call;
+                job_arg = &fn;
+                running = (int)threads.size();
+                phase++;
+            }
+            start_cv.notify_all();
+            fn(0);
+            std::unique_lock<std::mutex> guard(lock);
+            done_cv.wait(guard, [&] { return running == 0; });
+        }
+};
+
+// Ring slots for the bucket queue: every edge costs less than this, so pending costs never wrap
+// onto the bucket being expanded
+static const int FLOW_RING = 16;
+// Frontiers smaller than this are expanded on the calling thread alone
+static const size_t FLOW_PARALLEL_FRONTIER = 2048;
+
+flow_field::flow_field(): width(0), height(0), robot_w(0), robot_h(0), stride(0), capacity(0) {}
+
+flow_field::~flow_field() = default;
+
+void flow_field::build(const grid_util& grid, const goal_region& goal, int w, int h, int threads) {
+    width = grid.width();
+    height = grid.height();
+    robot_w = w;
+    robot_h = h;
+    stride = height + 2;
+    const size_t cells = (size_t)(width + 2)*stride;
+    if (cells > capacity) {
+        dist.reset(new std::atomic<int32_t>[cells]);
+        capacity = cells;
+    }
+    next_dir.assign(cells, FLOW_NONE);
+    free_pos.assign(cells, 0);
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+        threads = (threads > 0) ? threads : 1;
+    }
+    if (!pool || pool->size() != threads) {
+        pool.reset();
+        pool.reset(new phase_pool(threads));
+        out.assign((size_t)threads*FLOW_RING, std::vector<int32_t>());
+    }
+    ring.resize(FLOW_RING);
+    const int parts = pool->size();
+    auto columns = [&](int t, int& x0, int& x1) {
+        x0 = (int)((int64_t)width*t/parts);
+        x1 = (int)((int64_t)width*(t + 1)/parts);
+    };
+    // Neighbour offsets in the padded layout; the zero border stops every move off the map
+    int32_t offset[8];
+    for (int d = 0; d < 8; d++) {
+        offset[d] = dir_x[d]*stride + dir_y[d];
+    }
+
+    // Free positions, straight from the C-space layer when the grid keeps one for this footprint
+    const bool cspace = grid.has_footprint(robot_w, robot_h);
+    pool->run([&](int t) {
+        int x0, x1;
+        columns(t, x0, x1);
+        for (int x = x0; x < x1; x++) {
+            uint8_t* col = &free_pos[index(x, 0)];
+            const uint64_t* bits = cspace ? grid.cspace_row(x) : nullptr;
+            for (int y = 0; y < height; y++) {
+                col[y] = cspace ? !((bits[y >> 6] >> (y & 63)) & 1) : !position_blocked(grid, x, y, robot_w, robot_h);
+            }
+        }
+    });
+    for (size_t i = 0; i < cells; i++) {
+        dist[i].store(INT32_MAX, std::memory_order_relaxed);
+    }
+
+    // out[t*FLOW_RING + slot]: cells a thread lowered into that bucket, merged into the ring after
+    // each phase. Both end every build empty, with their capacity kept for the next one
+    size_t pending = 0;
+    for (int x = std::max(0, goal.x0); x <= std::min(width - 1, goal.x1); x++) {
+        for (int y = std::max(0, goal.y0); y <= std::min(height - 1, goal.y1); y++) {
+            if (free_pos[index(x, y)]) {
+                dist[index(x, y)].store(0, std::memory_order_relaxed);
+                ring[0].push_back((int32_t)index(x, y));
+                pending++;
+            }
+        }
+    }
+
+    // Expand cells [begin, end) of the current bucket, all settled at cost d. Moves are symmetric,
+    // so the moves out of a cell are also the moves into it. Only a shared expansion needs
+    // compare-and-swap; alone, a plain load and store lower the cost
+    auto expand = [&](const std::vector<int32_t>& bucket, size_t begin, size_t end, int32_t d, int t, bool shared) {
+        for (size_t k = begin; k < end; k++) {
+            const int32_t u = bucket[k];
+            if (dist[u].load(std::memory_order_relaxed) != d) {
+                continue;                   // stale entry, lowered again after it was queued
+            }
+            for (int dir = 0; dir < 8; dir++) {
+                const int32_t n = u + offset[dir];
+                if (!free_pos[n] || (dir >= 4 && !(free_pos[u + dir_x[dir]*stride] && free_pos[u + dir_y[dir]]))) {
+                    continue;
+                }
+                const int32_t nd = d + ((dir < 4) ? STRAIGHT_COST : DIAGONAL_COST);
+                std::atomic<int32_t>& slot = dist[n];
+                int32_t old = slot.load(std::memory_order_relaxed);
+                if (shared) {
+                    while (nd < old && !slot.compare_exchange_weak(old, nd, std::memory_order_relaxed)) {
+                    }
+                }
+                else if (nd < old) {
+                    slot.store(nd, std::memory_order_relaxed);
+                }
+                if (nd < old) {
+                    out[(size_t)t*FLOW_RING + nd % FLOW_RING].push_back(n);
+                }
+            }
+        }
+    };
+
+    for (int32_t d = 0; pending > 0; d++) {
+        std::vector<int32_t>& bucket = ring[d % FLOW_RING];
+        if (bucket.empty()) {
+            continue;
+        }
+        pending -= bucket.size();
+        if (bucket.size() < FLOW_PARALLEL_FRONTIER || parts == 1) {
+            expand(bucket, 0, bucket.size(), d, 0, false);
+        }
+        else {
+            const size_t n = bucket.size();
+            pool->run([&](int t) { expand(bucket, n*t/parts, n*(t + 1)/parts, d, t, true); });
+        }
+        bucket.clear();
+        for (int t = 0; t < parts; t++) {
+            for (int s = 0; s < FLOW_RING; s++) {
+                std::vector<int32_t>& local = out[(size_t)t*FLOW_RING + s];
+                if (!local.empty()) {
+                    ring[s].insert(ring[s].end(), local.begin(), local.end());
+                    pending += local.size();
+                    local.clear();
+                }
+            }
+        }
+    }
+
+    // Next hop of every position: the move that minimizes step cost plus the neighbour's cost.
+    // Independent per cell, so the columns are split evenly across the pool
+    pool->run([&](int t) {
+        int x0, x1;
+        columns(t, x0, x1);
+        for (int x = x0; x < x1; x++) {
+            for (int y = 0; y < height; y++) {
+                const int32_t i = (int32_t)index(x, y);
+                const int32_t here = dist[i].load(std::memory_order_relaxed);
+                if (here == INT32_MAX) {
+                    continue;
+                }
+                if (here == 0) {
+                    next_dir[i] = FLOW_GOAL;
+                    continue;
+                }
+                int32_t best = INT32_MAX;
+                for (int dir = 0; dir < 8; dir++) {
+                    const int32_t n = i + offset[dir];
+                    if (!free_pos[n] || (dir >= 4 && !(free_pos[i + dir_x[dir]*stride] && free_pos[i + dir_y[dir]]))) {
+                        continue;
+                    }
+                    const int32_t there = dist[n].load(std::memory_order_relaxed);
+                    const int32_t cost = (dir < 4) ? STRAIGHT_COST : DIAGONAL_COST;
+                    if (there != INT32_MAX && there + cost < best) {
+                        best = there + cost;
+                        next_dir[i] = (int8_t)dir;
+                    }
+                }
+            }
+        }
+    });
+}
+
+// O(1) per call: where a robot at (x, y) moves next. False inside the goal region, on blocked
+// positions and where the goal is unreachable
+bool flow_field::step(int x, int y, grid_point& next) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return false;
+    }
+    const int8_t dir = next_dir[index(x, y)];
+    if (dir < 0 || dir == FLOW_GOAL) {
+        return false;
+    }
+    next = grid_point{x + dir_x[dir], y + dir_y[dir]};
+    return true;
+}
+
+int32_t flow_field::cost_to_goal(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return INT32_MAX;
+    }
+    return dist[index(x, y)].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,265 @@
+// Path planners over grid_util. Positions are the robot's top-left corner; a position is free
+// when the corner is on the map and the robot's bounding box touches no obstacle cell
+#ifndef PLANNER
+#define PLANNER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "utils.h"
+
+struct grid_point {
+    int x, y;
+};
+
+// Positions that count as arrival, inclusive on both ends
+struct goal_region {
+    int x0, y0, x1, y1;
+};
+
+// 8-connected moves: straight steps cost 10, diagonal steps 14 (octile distance).
+// Diagonal steps need both neighbouring straight cells free, so paths never cut corners
+const int STRAIGHT_COST = 10;
+const int DIAGONAL_COST = 14;
+
+bool position_blocked(const grid_util&, int, int, int, int);
+int octile_to_region(int, int, const goal_region&);
+// Summed move costs of a path of adjacent positions
+int path_cost(const std::vector<grid_point>&);
+
+// Intrusive binary min-heap of cell indices, ordered by key[cell] (Key needs operator<). key and
+// pos are indexed by cell and sized once per map; pos[cell] is the cell's slot in heap while it
+// is queued. A planner changing a queued cell's key calls up() or down() on its slot
+template <typename Key>
+class cell_heap {
+    public:
+        std::vector<Key> key;
+        std::vector<int32_t> pos;
+        std::vector<int32_t> heap;
+
+        void assign(size_t cells) {
+            key.assign(cells, Key());
+            pos.assign(cells, -1);
+            heap.clear();
+        }
+        bool empty() const { return heap.empty(); }
+        int32_t top() const { return heap[0]; }
+        void push(int32_t cell) {
+            heap.push_back(cell);
+            up((int)heap.size() - 1);
+        }
+        int32_t pop() {
+            const int32_t cell = heap[0];
+            pos[cell] = -1;
+            heap[0] = heap.back();
+            heap.pop_back();
+            if (!heap.empty()) {
+                down(0);
+            }
+            return cell;
+        }
+        // Take a queued cell out, wherever it sits
+        void remove(int32_t cell) {
+            const int i = pos[cell];
+            pos[cell] = -1;
+            const int32_t last = heap.back();
+            heap.pop_back();
+            if (last == cell) {
+                return;
+            }
+            heap[i] = last;
+            pos[last] = i;
+            up(i);
+            down(pos[last]);
+        }
+        void up(int i) {
+            const int32_t item = heap[i];
+            while (i > 0) {
+                int parent = (i - 1) / 2;
+                if (!(key[item] < key[heap[parent]])) {
+                    break;
+                }
+                heap[i] = heap[parent];
+                pos[heap[i]] = i;
+                i = parent;
+            }
+            heap[i] = item;
+            pos[item] = i;
+        }
+        void down(int i) {
+            const int n = (int)heap.size();
+            const int32_t item = heap[i];
+            while (true) {
+                int child = 2*i + 1;
+                if (child >= n) {
+                    break;
+                }
+                if (child + 1 < n && key[heap[child + 1]] < key[heap[child]]) {
+                    child++;
+                }
+                if (!(key[heap[child]] < key[item])) {
+                    break;
+                }
+                heap[i] = heap[child];
+                pos[heap[i]] = i;
+                i = child;
+            }
+            heap[i] = item;
+            pos[item] = i;
+        }
+};
+
+// Open-list key of astar_planner and jps_planner: lower f first; on ties prefer the deeper node,
+// which keeps the search moving toward the goal
+struct astar_key {
+    int32_t f, g;
+    bool operator<(const astar_key& o) const { return f < o.f || (f == o.f && g > o.g); }
+};
+
+// Per-cell search state shared by the planners, allocated once per map size and reused across
+// queries. Instead of clearing the arrays, each query bumps a generation counter and cells
+// stamped with an older generation read as unvisited, so planning repeatedly on the same map
+// allocates nothing. The open list is a cell_heap keyed by f and g
+class search_pool {
+    int width, height;
+    uint32_t generation;
+    std::vector<uint32_t> stamp;            // generation in which the cell was last touched
+    public:
+        std::vector<uint8_t> state;         // OPEN / CLOSED / BLOCKED, valid when stamped
+        std::vector<int32_t> g_score;
+        std::vector<int32_t> parent;        // index of the predecessor cell
+        cell_heap<astar_key> open;
+
+        search_pool(): width(0), height(0), generation(0) {}
+        void begin(int, int);
+        // First touch of a cell in this query?
+        bool fresh(size_t i) {
+            if (stamp[i] == generation) {
+                return false;
+            }
+            stamp[i] = generation;
+            return true;
+        }
+};
+
+// A* over every grid position
+class astar_planner {
+    search_pool pool;
+    int expanded;
+    public:
+        astar_planner(): expanded(0) {}
+        bool plan(const grid_util&, grid_point, const goal_region&, int, int, std::vector<grid_point>&);
+        int nodes_expanded() const { return expanded; }
+};
+
+// Jump Point Search over the same 8-connected, no-corner-cutting moves as astar_planner, so it
+// finds paths of the same optimal cost. prepare() takes the grid's C-space layer (or dilates the
+// obstacle bitmap itself) into a bitset of blocked positions, stored both column-wise (bits along y) and
+// row-wise (bits along x), so every straight jump is a word-at-a-time scan
+class jps_planner {
+    search_pool pool;
+    int width, height;
+    int robot_w, robot_h;
+    int col_words, row_words;
+    std::vector<uint64_t> col_bits;         // [x][y / 64], bit set = blocked
+    std::vector<uint64_t> row_bits;         // [y][x / 64], bit set = blocked
+    int expanded;
+
+    bool blocked(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return true;
+        }
+        return (col_bits[(size_t)x*col_words + (y >> 6)] >> (y & 63)) & 1;
+    }
+    bool jump_straight(int, int, int, int, const goal_region&, int&, int&) const;
+    bool jump(int, int, int, int, const goal_region&, int&, int&) const;
+    public:
+        jps_planner(): width(0), height(0), robot_w(0), robot_h(0), col_words(0), row_words(0), expanded(0) {}
+        void prepare(const grid_util&, int, int);
+        bool plan(grid_point, const goal_region&, std::vector<grid_point>&);
+        int nodes_expanded() const { return expanded; }
+};
+
+// D* Lite (Koenig & Likhachev) over the same moves and footprint rules as astar_planner. The
+// search runs backwards from the goal region to the robot, so when cells change under a running
+// plan, notify_changed() re-evaluates only the positions next to the edit and the next
+// next_step() repairs the affected part of the previous search instead of starting over.
+// Keeps a pointer to the grid between calls; the grid must outlive the run
+class dstar_planner {
+    const grid_util* grid;
+    goal_region goal;
+    int width, height;
+    int robot_w, robot_h;
+    grid_point start_pos, last_pos;         // robot now, and where it was at the last change
+    int64_t km;                             // key offset accumulated as the robot moves
+    uint32_t generation;
+    std::vector<uint32_t> stamp;            // cells of an older generation read as g = rhs = INF
+    std::vector<int32_t> g, rhs;
+    // Queue key [k1; k2], compared lexicographically
+    struct key {
+        int64_t k1;
+        int32_t k2;
+        bool operator<(const key& o) const { return k1 < o.k1 || (k1 == o.k1 && k2 < o.k2); }
+    };
+    cell_heap<key> open;
+    int expanded;
+
+    void touch(int32_t);
+    int32_t g_of(int32_t i) const;
+    bool in_goal(int x, int y) const { return x >= goal.x0 && x <= goal.x1 && y >= goal.y0 && y <= goal.y1; }
+    bool blocked(int x, int y) const { return position_blocked(*grid, x, y, robot_w, robot_h); }
+    int32_t step_cost(int, int, int) const;
+    key calc_key(int32_t) const;
+    void settle(int32_t);
+    void update_vertex(int, int);
+    void compute_shortest_path();
+    public:
+        dstar_planner(): grid(nullptr), goal{0, 0, -1, -1}, width(0), height(0), robot_w(0), robot_h(0),
+            start_pos{0, 0}, last_pos{0, 0}, km(0), generation(0), expanded(0) {}
+        bool start(const grid_util&, grid_point, const goal_region&, int, int);
+        // Cells in the inclusive rectangle [x0,x1] x [y0,y1] were rewritten
+        void notify_changed(int, int, int, int);
+        // Move one position along the current shortest path; false at the goal or with no path
+        bool next_step(grid_point&);
+        // Cost of the shortest path from the current position after repairing the search; -1 if none
+        int32_t path_cost();
+        grid_point position() const { return start_pos; }
+        int nodes_expanded() const { return expanded; }
+};
+
+// Goal-rooted flow field: one Dijkstra wavefront from the goal region over the same moves and
+// footprint rules as the planners gives every position its cost to the goal and its next hop,
+// so any number of robots of that footprint heading to that goal step by table lookup.
+// The wavefront runs over a ring of cost buckets (edge costs are 10 and 14); buckets with a large
+// frontier are expanded by all threads at once, relaxing costs with atomic compare-and-swap
+const int8_t FLOW_GOAL = 8;                 // next_dir inside the goal region
+const int8_t FLOW_NONE = -1;                // blocked, or no route to the goal
+
+class phase_pool;
+
+class flow_field {
+    int width, height;
+    int robot_w, robot_h;
+    int stride;                             // height + 2: every array has a one-cell border
+    size_t capacity;
+    std::unique_ptr<std::atomic<int32_t>[]> dist;
+    std::vector<int8_t> next_dir;           // direction index into the move table
+    std::vector<uint8_t> free_pos;          // 1 where the footprint fits, 0 on the border
+    //Kept across builds, so a rebuild after a late obstacle neither starts threads nor allocates:
+    //the worker pool, the ring of cost buckets and each thread's per-bucket output
+    std::unique_ptr<phase_pool> pool;
+    std::vector<std::vector<int32_t>> ring, out;
+    size_t index(int x, int y) const { return (size_t)(x + 1)*stride + y + 1; }
+    public:
+        flow_field();
+        ~flow_field();
+        // threads: 0 = all cores. The pool is only restarted when the count changes; one thread
+        // suits the lab map, large maps gain from more
+        void build(const grid_util&, const goal_region&, int, int, int threads = 1);
+        bool step(int x, int y, grid_point& next) const;
+        int32_t cost_to_goal(int x, int y) const;
+        int8_t direction(int x, int y) const { return next_dir[index(x, y)]; }
+};
+
+#endif
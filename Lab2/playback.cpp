@@ -0,0 +1,130 @@
+#include <cstring>
+#include <iostream>
+#include "playback.h"
+
+// Binary trajectory file, native byte order: this tag; the seed (uint64); map width, height,
+// succeed flag and obstacle count (int32 each); robot_init, goal_init and every obstacle as four
+// int32 (x, y, width, height); then raw traj_point pairs to the end of the file
+static const char traj_magic[8] = {'M', 'T', 'E', 'T', 'R', 'J', '0', '2'};
+
+sample_status trajectory_view_source::next(traj_point& p) {
+    if (pos >= points.size()) {
+        return SAMPLE_END;
+    }
+    p = points[pos++];
+    return SAMPLE_READY;
+}
+
+trajectory_file_source::trajectory_file_source(const std::string& filename, size_t chunk_points):
+    file(std::fopen(filename.c_str(), "rb")),
+    saved{0, 0, 0, Object{0, 0, 0, 0}, Object{0, 0, 0, 0}, false, {}},
+    chunk(chunk_points > 0 ? chunk_points : 1),
+    pos(0),
+    filled(0)
+{
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return;
+    }
+    if (!read_header()) {
+        std::cerr << "Error: " << filename << " is not a trajectory file" << std::endl;
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+static bool read_object(std::FILE* file, Object& o) {
+    int32_t v[4];
+    if (std::fread(v, sizeof(int32_t), 4, file) != 4) {
+        return false;
+    }
+    o = Object{v[0], v[1], v[2], v[3]};
+    return true;
+}
+
+bool trajectory_file_source::read_header() {
+    char magic[sizeof(traj_magic)];
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, traj_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    int32_t fields[4];
+    if (std::fread(&saved.seed, sizeof(saved.seed), 1, file) != 1 || std::fread(fields, sizeof(int32_t), 4, file) != 4) {
+        return false;
+    }
+    saved.width = fields[0];
+    saved.height = fields[1];
+    saved.succeed = fields[2] != 0;
+    if (fields[3] < 0 || !read_object(file, saved.robot_init) || !read_object(file, saved.goal_init)) {
+        return false;
+    }
+    // Grown one read at a time, so a corrupt count runs into the end of the file, not a huge allocation
+    saved.objects.clear();
+    Object o;
+    for (int32_t i = 0; i < fields[3]; i++) {
+        if (!read_object(file, o)) {
+            return false;
+        }
+        saved.objects.push_back(o);
+    }
+    return true;
+}
+
+trajectory_file_source::~trajectory_file_source() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+sample_status trajectory_file_source::next(traj_point& p) {
+    if (pos == filled) {
+        if (!file) {
+            return SAMPLE_END;
+        }
+        filled = std::fread(chunk.data(), sizeof(traj_point), chunk.size(), file);
+        pos = 0;
+        if (filled == 0) {
+            return SAMPLE_END;
+        }
+    }
+    p = chunk[pos++];
+    return SAMPLE_READY;
+}
+
+static bool write_object(std::FILE* file, const Object& o) {
+    const int32_t v[4] = {o.x, o.y, o.width, o.height};
+    return std::fwrite(v, sizeof(int32_t), 4, file) == 4;
+}
+
+// Save a run for later streamed playback
+bool write_trajectory(const std::string& filename, const trajectory_header& header, array_view<traj_point> points) {
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    const int32_t fields[4] = {header.width, header.height, header.succeed, (int32_t)header.objects.size()};
+    bool ok = std::fwrite(traj_magic, 1, sizeof(traj_magic), file) == sizeof(traj_magic);
+    ok = ok && std::fwrite(&header.seed, sizeof(header.seed), 1, file) == 1;
+    ok = ok && std::fwrite(fields, sizeof(int32_t), 4, file) == 4;
+    ok = ok && write_object(file, header.robot_init) && write_object(file, header.goal_init);
+    for (size_t i = 0; ok && i < header.objects.size(); i++) {
+        ok = write_object(file, header.objects[i]);
+    }
+    ok = ok && std::fwrite(points.data(), sizeof(traj_point), points.size(), file) == points.size();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Error: Could not write trajectory to " << filename << std::endl;
+    }
+    return ok;
+}
+
+bool is_trajectory_file(const std::string& filename) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(traj_magic)];
+    const bool tagged = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, traj_magic, sizeof(magic)) == 0;
+    std::fclose(file);
+    return tagged;
+}
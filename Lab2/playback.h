@@ -0,0 +1,64 @@
+// Trajectory playback sources for the renderer: in-memory views, and binary files read in chunks
+#ifndef PLAYBACK
+#define PLAYBACK
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+enum sample_status {
+    SAMPLE_READY,                           // a sample was written to the output
+    SAMPLE_END                              // trajectory finished
+};
+
+// Everything a trajectory file holds besides the samples: which run it is, and the scene needed
+// to draw it without simulating again
+struct trajectory_header {
+    uint64_t seed;
+    int32_t width, height;                  // map size
+    Object robot_init, goal_init;
+    bool succeed;
+    std::vector<Object> objects;
+};
+
+// Pull-based supply of trajectory samples
+class trajectory_source {
+    public:
+        virtual ~trajectory_source() {}
+        virtual sample_status next(traj_point&) = 0;
+};
+
+// Walks an in-memory trajectory without copying it
+class trajectory_view_source : public trajectory_source {
+    array_view<traj_point> points;
+    size_t pos;
+    public:
+        explicit trajectory_view_source(array_view<traj_point> p): points(p), pos(0) {}
+        sample_status next(traj_point&) override;
+};
+
+// Streams a file written by write_trajectory, holding only one chunk in memory. The header is
+// read up front; a file that is missing, truncated or of another format leaves is_open() false
+class trajectory_file_source : public trajectory_source {
+    std::FILE* file;
+    trajectory_header saved;
+    std::vector<traj_point> chunk;
+    size_t pos, filled;
+    bool read_header();
+    public:
+        explicit trajectory_file_source(const std::string&, size_t chunk_points = 4096);
+        ~trajectory_file_source();
+        trajectory_file_source(const trajectory_file_source&) = delete;
+        trajectory_file_source& operator=(const trajectory_file_source&) = delete;
+        bool is_open() const { return file != nullptr; }
+        const trajectory_header& header() const { return saved; }
+        sample_status next(traj_point&) override;
+};
+
+bool write_trajectory(const std::string&, const trajectory_header&, array_view<traj_point>);
+// Does the file start with the trajectory tag? Quiet when it is missing or of another format
+bool is_trajectory_file(const std::string&);
+
+#endif
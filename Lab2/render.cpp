@@ -1,11 +1,12 @@
 #include <SFML/Graphics.hpp>
+#include <climits>
 #include <cmath>
 #include <iostream>
 #include <random>
 #include <vector>
 
 // #include "drawobjects.h"
-#include "utils.h"
+#include "render.h"
 
 // Text colours
 const std::string RED = "\033[31m";   // Red text
@@ -19,9 +20,30 @@ sf::RectangleShape draw_object(int x, int y, int width, int height) {
     return obj;  
 }
 
+// Append an axis-aligned rectangle as one quad
+static void append_rect(sf::VertexArray& quads, int x, int y, int width, int height, sf::Color color) {
+    quads.append(sf::Vertex(sf::Vector2f(x, y), color));
+    quads.append(sf::Vertex(sf::Vector2f(x + width, y), color));
+    quads.append(sf::Vertex(sf::Vector2f(x + width, y + height), color));
+    quads.append(sf::Vertex(sf::Vector2f(x, y + height), color));
+}
+
 void render_window(
-    std::vector<std::vector<int>> robot_pos,
-    std::vector<Object> objects, 
+    array_view<traj_point> robot_pos,
+    array_view<Object> objects, 
+    Object robot, 
+    Object goal, 
+    int width, 
+    int height,
+    bool succeed)
+{
+    trajectory_view_source source(robot_pos);
+    render_window(source, objects, robot, goal, width, height, succeed);
+}
+
+void render_window(
+    trajectory_source& robot_pos,
+    array_view<Object> objects, 
     Object robot, 
     Object goal, 
     int width, 
@@ -49,38 +71,48 @@ void render_window(
     sf::Vector2f robotPosition(robot.x, robot.y);
     robot_draw.setPosition(robotPosition);
 
-    sf::RectangleShape goal_draw(sf::Vector2f(goal.width, goal.height));
-    sf::Vector2f goalPosition(goal.x, goal.y);
-    
-    goal_draw.setPosition(goalPosition);
-    goal_draw.setFillColor(sf::Color::Green);    
-
-    std::vector<sf::RectangleShape> objects_draw;
-    // Now spawn the objects in SFML. 
-    // For some reason size() returns vector size * # struct members, so divide by # struct members (4)
-    for (int i = 0; i < objects.size(); i++) {
-        objects_draw.push_back(draw_object(objects[i].x, objects[i].y, objects[i].width, objects[i].height));
+    // The goal and obstacles never move, so build them once into a single vertex array.
+    // Each frame then costs one draw call for the scene however many obstacles there are
+    sf::VertexArray scene_draw(sf::Quads);
+    append_rect(scene_draw, goal.x, goal.y, goal.width, goal.height, sf::Color::Green);
+    for (size_t i = 0; i < objects.size(); i++) {
+        // Objects that failed to spawn are left zero-sized
+        if (objects[i].width > 0 && objects[i].height > 0) {
+            append_rect(scene_draw, objects[i].x, objects[i].y, objects[i].width, objects[i].height, sf::Color::White);
+        }
     }
 
-    std::vector<sf::RectangleShape>::iterator i;
     int count = 0;
     bool isPaused = false; // State to track whether the game is paused
 
+    // Playback controls: samples advanced per frame, a pending jump to the end, and single
+    // steps queued while paused
+    int speed = 1;
+    bool jump_to_end = false;
+    int steps_requested = 0;
+    std::cout << "Playback: 1/2/3 = 1x/10x/100x, End = jump to end, Space = pause, Right = step" << std::endl;
+
+    // Keep one sample of lookahead so the frame showing the last sample is the final frame
+    traj_point ahead;
+    sample_status ahead_status = robot_pos.next(ahead);
+    bool finished = (ahead_status == SAMPLE_END);
+
+    // Move to the next sample
+    auto advance = [&]() {
+        if (ahead_status == SAMPLE_READY) {
+            robotPosition.x = ahead.x;
+            robotPosition.y = ahead.y;
+        }
+        if (ahead_status != SAMPLE_END) {
+            ahead_status = robot_pos.next(ahead);
+        }
+        finished = (ahead_status == SAMPLE_END);
+    };
+
     // run the program as long as the window is open
     while (window.isOpen())
     {
 
-        // Error handling for index out of bounds events
-        if (count < robot_pos.size() && robot_pos[count].size() >= 2) {
-            robotPosition.x = robot_pos[count][0]; // Safe access
-            robotPosition.y = robot_pos[count][1]; // Safe access
-        } else {
-            if (count < 200) {
-                std::cerr << "Error: Accessing out of bounds for robot_pos at count: " << count << std::endl;
-                // Handle error appropriately (e.g., skip iteration, set defaults, etc.)
-            }
-        }
-
         // check all the window's events that were triggered since the last iteration of the loop
         sf::Event event;
         while (window.pollEvent(event))
@@ -89,27 +121,53 @@ void render_window(
             if(event.type == sf::Event::Closed){
                 window.close();
             }
+            if (event.type == sf::Event::KeyPressed) {
+                switch (event.key.code) {
+                    case sf::Keyboard::Num1: speed = 1; break;
+                    case sf::Keyboard::Num2: speed = 10; break;
+                    case sf::Keyboard::Num3: speed = 100; break;
+                    case sf::Keyboard::End: jump_to_end = true; break;
+                    case sf::Keyboard::Space: isPaused = !isPaused; break;
+                    case sf::Keyboard::Right: steps_requested++; break;
+                    default: break;
+                }
+            }
         }
 
-        // clear the window
-        window.clear();
-
-        // Drawing operations
-        robot_draw.setPosition(robotPosition);
-        window.draw(robot_draw);
-        window.draw(goal_draw);
-        // window.draw(line);
-        for (i = objects_draw.begin(); i != objects_draw.end(); ++i){
-            window.draw(*i);
+        // Skip intermediate samples at higher speeds; the last sample is always shown before closing
+        int samples = isPaused ? steps_requested : speed;
+        steps_requested = 0;
+        if (jump_to_end) {
+            samples = INT_MAX;
+            jump_to_end = false;
         }
-
-        if ((count >= robot_pos.size()-1) && succeed) {
-            std::cout << GREEN << "Success! Goal reached!" << RESET << std::endl;
-            window.close();
+        for (int k = 0; k < samples && !finished; k++) {
+            advance();
         }
-        if ((count >= robot_pos.size()-1) && !succeed) {
-            std::cout << RED << "Failure! Collision!" << RESET << std::endl;
-            window.close();
+
+        // Time only the drawing: not the event handling or trajectory advance, and not display(),
+        // which sleeps to hold the frame rate limit
+        {
+            PROF_SCOPE(PHASE_RENDER);
+            PROF_COUNT(COUNTER_FRAMES, 1);
+
+            // clear the window
+            window.clear();
+
+            // Drawing operations
+            window.draw(scene_draw);
+            robot_draw.setPosition(robotPosition);
+            window.draw(robot_draw);
+            // window.draw(line);
+
+            if (finished && succeed) {
+                std::cout << GREEN << "Success! Goal reached!" << RESET << std::endl;
+                window.close();
+            }
+            if (finished && !succeed) {
+                std::cout << RED << "Failure! Collision!" << RESET << std::endl;
+                window.close();
+            }
         }
 
         // end the current frame
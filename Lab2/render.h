@@ -2,6 +2,7 @@
 
 #include <SFML/Graphics.hpp>
 #include <vector>
+#include "playback.h"
 #include "utils.h"
 
 #ifndef RENDER
@@ -9,9 +10,20 @@
 
 sf::RectangleShape draw_object(int, int, int, int);
 
+// Play back a trajectory held in memory; nothing is copied
 void render_window(
-    std::vector<std::vector<int>>, 
-    std::vector<Object>, 
+    array_view<traj_point>, 
+    array_view<Object>, 
+    Object, 
+    Object, 
+    int, 
+    int, 
+    bool);
+
+// Play back samples as a source yields them, e.g. streamed from a trajectory file
+void render_window(
+    trajectory_source&, 
+    array_view<Object>, 
     Object, 
     Object, 
     int, 
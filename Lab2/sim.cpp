@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sim.h"
+
+episode_context::episode_context():
+    grid(width, height, min_obj_size, max_obj_size),
+    rand_gen(random_generator::random_seed(), RNG_XOSHIRO256),
+    robot_init{0, 0, 0, 0},
+    goal_init{0, 0, 0, 0},
+    succeed(false),
+    verbose(true),
+    options{POLICY_ASTAR, COLLISION_BOX, 0, 1}
+{
+    // Room for a capped run plus some avoidance detours; clear() keeps it between episodes
+    robot_pos.reserve(2*max_steps);
+    // Keep a C-space layer for the robot's box so planners and collision checks treat it as a point
+    grid.set_footprint(2*radius, 2*radius);
+}
+
+// Check to see if it collides with the goal
+bool is_goal_detected(const Object& robot, const Object& goal) {
+    return !(robot.x + robot.width <= goal.x ||
+             robot.x >= goal.x + goal_width ||
+             robot.y + robot.height <= goal.y ||
+             robot.y >= goal.y + goal_height);
+}
+
+// Assuming each grid cell represents 1 pixel
+const int grid_cell_width = 1;
+const int grid_cell_height = 1;
+
+// This function checks for collisions by testing the robot's bounding box against the grid's obstacles,
+// with COLLISION_CIRCLE by testing the disc at the robot's centre against the obstacle rectangles
+// (the distance field for many), or with COLLISION_OBJECTS by testing the bounding box against the obstacle rectangles (a SIMD scan, or the R-tree for many)
+bool is_collision(episode_context& ctx, const Object& robot) {
+    PROF_COUNT(COUNTER_COLLISION_CHECKS, 1);
+    if (ctx.options.collision == COLLISION_CIRCLE) {
+        const int center_x = robot.x + robot.width/2, center_y = robot.y + robot.height/2;
+        // A centre off the map reads as clear, as in the distance field
+        const bool on_map = center_x >= 0 && center_y >= 0 && center_x < ctx.grid.width() && center_y < ctx.grid.height();
+        const bool hit = !on_map ? false
+            : (ctx.batch.size() <= BATCH_SCAN_LIMIT) ? ctx.batch.circle_hits(center_x, center_y, radius)
+            : ctx.clearance.circle_hits_obstacle(center_x, center_y, radius);
+        if (hit) {
+            if (ctx.verbose) std::cout << "Collision detected around (" << center_x << ", " << center_y << ")" << std::endl;
+            return true;
+        }
+        return false;
+    }
+    if (ctx.options.collision == COLLISION_OBJECTS) {
+        // Clipped to the map like the grid's box check; obstacles may reach one column past it
+        const int x1 = std::min(robot.x + robot.width, ctx.grid.width() - 1);
+        const int y1 = std::min(robot.y + robot.height, ctx.grid.height() - 1);
+        const bool hit = (robot.x > x1 || robot.y > y1) ? false
+            : (ctx.batch.size() <= BATCH_SCAN_LIMIT) ? ctx.batch.rect_hits(robot.x, robot.y, x1, y1)
+            : ctx.obstacles.box_hits(robot.x, robot.y, x1, y1);
+        if (hit) {
+            if (ctx.verbose) std::cout << "Collision detected with an obstacle around (" << robot.x << ", " << robot.y << ")" << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+    // Convert robot's position to grid coordinates
+    int grid_top_left_x = robot.x / grid_cell_width;
+    int grid_top_left_y = robot.y / grid_cell_height;
+    int grid_bottom_right_x = (robot.x + robot.width) / grid_cell_width;
+    int grid_bottom_right_y = (robot.y + robot.height) / grid_cell_height;
+
+    // Obstacles are never smaller than the robot, so testing the whole box matches the old edge walk.
+    // For the robot's own size that is one bit of the C-space layer while the corner is on the map
+    const bool on_map = robot.x >= 0 && robot.y >= 0 && robot.x < ctx.grid.width() && robot.y < ctx.grid.height();
+    const bool hit = (on_map && ctx.grid.has_footprint(robot.width, robot.height))
+        ? ctx.grid.cspace_at(robot.x, robot.y)
+        : ctx.grid.box_has_obstacle(grid_top_left_x, grid_top_left_y, grid_bottom_right_x, grid_bottom_right_y);
+    if (hit) {
+        if (ctx.verbose) std::cout << "Collision detected in box (" << grid_top_left_x << ", " << grid_top_left_y << ") to (" << grid_bottom_right_x << ", " << grid_bottom_right_y << ")" << std::endl;
+        return true;
+    }
+
+    // If no collision detected, return false
+    return false;
+}
+
+// Obstacle avoidance function (Task 2) with smaller step sizes
+void obstacle_avoidance(episode_context& ctx, Object& robot, const Object& goal, bool moving_x) {
+    bool obstacle_cleared = false;
+    
+    // Move perpendicular to current movement direction until the robot clears the obstacle
+    while (is_collision(ctx, robot)) {
+        PROF_COUNT(COUNTER_AVOIDANCE_ITERATIONS, 1);
+        // Move in smaller steps to avoid skipping over obstacles
+        int step_size = 1;
+
+        if (moving_x) {
+            // If moving in x, shift in y to clear the obstacle
+            robot.y += (goal.y > robot.y) ? step_size : -step_size;
+        } else {
+            // If moving in y, shift in x to clear the obstacle
+            robot.x += (goal.x > robot.x) ? step_size : -step_size;
+        }
+
+        // Update the robot's position vector for rendering
+        ctx.robot_pos.push_back({robot.x, robot.y});
+
+        // If no more collisions are detected, mark the obstacle as cleared
+        if (!is_collision(ctx, robot)) {
+            obstacle_cleared = true;
+        }
+    }
+
+    // Ensure the robot has moved sufficiently away from the obstacle before recalculating the path
+    if (obstacle_cleared && ctx.verbose) {
+        std::cout << "Obstacle cleared! Recalculating path towards the goal." << std::endl;
+    }
+    if (obstacle_cleared) {
+        ctx.robot_pos.push_back({robot.x, robot.y});  // Force update after obstacle clearance
+    }
+}
+
+// Task 3 movement logic (x direction first)
+void moveRobotTask3(episode_context& ctx, Object& robot, const Object& goal) {
+    int target_x = goal.x;
+    int target_y = goal.y;
+    int dx = 0, dy = 0;
+
+    // Move in x direction first
+    if (robot.x < target_x) {
+        dx = 1;
+    } else if (robot.x > target_x) {
+        dx = -1;
+    }
+    // If x is aligned, move in y direction
+    else if (robot.y > target_y) {
+        dy = -1;
+    } else if (robot.y < target_y) {
+        dy = 1;
+    }
+
+    // Move robot
+    robot.x += dx;
+    robot.y += dy;
+
+    // Update the robot's position after movement
+    ctx.robot_pos.push_back({robot.x, robot.y});
+}
+
+// Task 4 movement logic (y direction first)
+void moveRobotTask4(episode_context& ctx, Object& robot, const Object& goal) {
+    int target_x = goal.x;
+    int target_y = goal.y;
+    int dx = 0, dy = 0;
+
+    // Move in y direction first
+    if (robot.y > target_y) {
+        dy = -1;
+    } else if (robot.y < target_y) {
+        dy = 1;
+    }
+    // If y is aligned, move in x direction
+    else if (robot.x < target_x) {
+        dx = 1;
+    } else if (robot.x > target_x) {
+        dx = -1;
+    }
+
+    // Move robot
+    robot.x += dx;
+    robot.y += dy;
+
+    // Update the robot's position after movement
+    ctx.robot_pos.push_back({robot.x, robot.y});
+}
+
+// Robot top-left positions at which is_goal_detected reports an overlap with the goal
+goal_region robot_goal_region(const Object& robot, const Object& goal) {
+    return goal_region{goal.x - robot.width + 1, goal.y - robot.height + 1,
+                       goal.x + goal_width - 1, goal.y + goal_height - 1};
+}
+
+// Past BATCH_SCAN_LIMIT obstacles the brute-force scan loses, so COLLISION_CIRCLE falls back to
+// the distance field and COLLISION_OBJECTS to the R-tree. Rebuilt whenever an obstacle is added
+static void index_many_obstacles(episode_context& ctx)
+{
+    if (ctx.batch.size() <= BATCH_SCAN_LIMIT) {
+        return;
+    }
+    if (ctx.options.collision == COLLISION_CIRCLE) {
+        ctx.clearance.build(ctx.grid);
+    }
+    else {
+        ctx.obstacles.build(ctx.objects);
+    }
+}
+
+// Load ctx.objects into the collision backends of the circle and objects models. The
+// brute-force SIMD scan wins for a few thousand obstacles and is always kept
+void index_obstacles(episode_context& ctx)
+{
+    if (ctx.options.collision == COLLISION_BOX) {
+        return;
+    }
+    ctx.batch.assign(ctx.objects);
+    index_many_obstacles(ctx);
+}
+
+// Every late_drop_interval steps, up to options.late_objects times, drop a new obstacle somewhere
+// within late_drop_range of the robot, clear of the robot and of everything already placed.
+// Returns true with the new obstacle in `dropped` when one landed
+static bool drop_late_obstacle(episode_context& ctx, const Object& robot, int step, Object& dropped)
+{
+    if (step == 0 || step % late_drop_interval != 0 || step/late_drop_interval > ctx.options.late_objects) {
+        return false;
+    }
+    int size[2];
+    for (int tries = 0; tries < 100; tries++) {
+        ctx.rand_gen.fill_random(size, 2, min_obj_size/2, max_obj_size/2);
+        const int x = ctx.rand_gen.create_random(std::max(0, robot.x - late_drop_range), std::min(width - size[0], robot.x + late_drop_range));
+        const int y = ctx.rand_gen.create_random(std::max(0, robot.y - late_drop_range), std::min(height - size[1], robot.y + late_drop_range));
+        const bool on_robot = x <= robot.x + robot.width + occupancy_tol && robot.x <= x + size[0] + occupancy_tol &&
+                              y <= robot.y + robot.height + occupancy_tol && robot.y <= y + size[1] + occupancy_tol;
+        if (on_robot || ctx.grid.is_occupied(occupancy_tol, x, y, size[0], size[1])) {
+            continue;
+        }
+        ctx.grid.occupy_grid(0, x, y, size[0], size[1], CELL_OBSTACLE, "obstacle");
+        dropped = Object{x, y, size[0], size[1]};
+        ctx.objects.push_back(dropped);
+        if (ctx.options.collision != COLLISION_BOX) {
+            ctx.batch.push_back(dropped);
+            index_many_obstacles(ctx);
+        }
+        if (ctx.verbose) std::cout << "Obstacle dropped at (" << x << ", " << y << ")" << std::endl;
+        return true;
+    }
+    return false;
+}
+
+// Task 3 movement with perpendicular obstacle avoidance. Returns the number of steps taken
+static int drive_greedy(episode_context& ctx, Object& robot, const Object& goal, episode_result& result)
+{
+    int max_count = 0;
+    Object dropped;
+
+    // Main loop using Task 3 logic and improved obstacle avoidance
+    while (true) {
+        drop_late_obstacle(ctx, robot, max_count, dropped);
+
+        // Move the robot using Task 3 logic (x direction first)
+        moveRobotTask3(ctx, robot, goal);
+        
+        // Check for collision after each movement
+        if (is_collision(ctx, robot)) {
+            if (ctx.verbose) std::cout << "Collision detected! Avoiding obstacle." << std::endl;
+            result.collisions++;
+            obstacle_avoidance(ctx, robot, goal, true);  // Pass the goal to obstacle_avoidance
+        }
+
+        // Add the robot's new position to robot_positions (dropped if the move already recorded it)
+        ctx.robot_pos.push_back({robot.x, robot.y});
+
+        // Check if the robot has reached the goal
+        if (is_goal_detected(robot, goal)) {
+            ctx.succeed = true;
+            if (ctx.verbose) std::cout << "Success! Goal reached!" << std::endl;
+            break;
+        }
+
+        max_count++;
+        if (max_count >= max_steps) {
+            if (ctx.verbose) std::cout << "=====1 minute reached with no solution=====" << std::endl;
+            break;
+        }
+
+        if (ctx.verbose && max_count % 100 == 0) {
+            std::cout << "Iteration " << max_count << ": Robot at (" << robot.x << ", " << robot.y << ")" << std::endl;
+        }
+    }
+    return max_count;
+}
+
+// Step loop shared by the planned policies. Until the robot reaches the goal or max_steps run
+// out: maybe drop a late obstacle and pass it to on_drop, ask next_step for the next position,
+// move there, record it and count a collision if the map changed under the plan. Returns the
+// number of steps taken
+template <typename Step, typename Drop>
+static int follow_steps(episode_context& ctx, Object& robot, const Object& goal, episode_result& result,
+                        Step next_step, Drop on_drop)
+{
+    int max_count = 0;
+    Object dropped;
+    grid_point next;
+    while (!is_goal_detected(robot, goal)) {
+        if (drop_late_obstacle(ctx, robot, max_count, dropped)) {
+            on_drop(dropped);
+        }
+        if (!next_step(next)) {
+            if (ctx.verbose) std::cout << "No path to the goal" << std::endl;
+            break;
+        }
+        robot.x = next.x;
+        robot.y = next.y;
+        ctx.robot_pos.push_back({robot.x, robot.y});
+
+        // Plans keep the whole footprint clear, so this only fires if the map changed under one
+        if (is_collision(ctx, robot)) {
+            result.collisions++;
+        }
+
+        max_count++;
+        if (max_count >= max_steps) {
+            if (ctx.verbose) std::cout << "=====1 minute reached with no solution=====" << std::endl;
+            break;
+        }
+    }
+    if (is_goal_detected(robot, goal)) {
+        ctx.succeed = true;
+        if (ctx.verbose) std::cout << "Success! Goal reached!" << std::endl;
+    }
+    return max_count;
+}
+
+// Plan once from the spawn point (A* or JPS per ctx.options), then follow the path one cell per
+// step. Late obstacles are not replanned around
+static int drive_planned(episode_context& ctx, Object& robot, const Object& goal, episode_result& result)
+{
+    const goal_region region = robot_goal_region(robot, goal);
+    bool found;
+    int expanded;
+    if (ctx.options.policy == POLICY_JPS) {
+        ctx.jps.prepare(ctx.grid, robot.width, robot.height);
+        found = ctx.jps.plan(grid_point{robot.x, robot.y}, region, ctx.path);
+        expanded = ctx.jps.nodes_expanded();
+    }
+    else {
+        found = ctx.planner.plan(ctx.grid, grid_point{robot.x, robot.y}, region, robot.width, robot.height, ctx.path);
+        expanded = ctx.planner.nodes_expanded();
+    }
+    if (!found) {
+        if (ctx.verbose) std::cout << "No path to the goal" << std::endl;
+        return 0;
+    }
+    if (ctx.verbose) std::cout << "Planned " << ctx.path.size() << " positions, " << expanded << " nodes expanded" << std::endl;
+
+    size_t i = 1;
+    return follow_steps(ctx, robot, goal, result,
+        [&](grid_point& next) {
+            if (i >= ctx.path.size()) {
+                return false;
+            }
+            next = ctx.path[i++];
+            return true;
+        },
+        [](const Object&) {});
+}
+
+#ifdef CHECK_REPLAN
+// Regression check for the D* repair: after a drop, the repaired path must cost as much as a
+// fresh A* search over the edited map. Aborts on a mismatch
+static void check_replan(episode_context& ctx, const Object& robot, const Object& goal)
+{
+    std::vector<grid_point> fresh;
+    const bool found = ctx.planner.plan(ctx.grid, grid_point{robot.x, robot.y}, robot_goal_region(robot, goal), robot.width, robot.height, fresh);
+    const int expected = found ? path_cost(fresh) : -1;
+    const int repaired = ctx.dstar.path_cost();
+    if (repaired != expected) {
+        std::cerr << "Error: seed " << ctx.rand_gen.seed() << ", D* path cost " << repaired << " after a drop, A* finds " << expected << std::endl;
+        std::abort();
+    }
+}
+#endif
+
+// Follow D* Lite one step at a time; each dropped obstacle is reported to the planner, which
+// repairs its search around the change before the next step
+static int drive_dstar(episode_context& ctx, Object& robot, const Object& goal, episode_result& result)
+{
+    if (!ctx.dstar.start(ctx.grid, grid_point{robot.x, robot.y}, robot_goal_region(robot, goal), robot.width, robot.height)) {
+        if (ctx.verbose) std::cout << "No path to the goal" << std::endl;
+        return 0;
+    }
+    if (ctx.verbose) std::cout << "Planned with " << ctx.dstar.nodes_expanded() << " nodes expanded" << std::endl;
+
+    const int steps = follow_steps(ctx, robot, goal, result,
+        [&](grid_point& next) { return ctx.dstar.next_step(next); },
+        [&](const Object& dropped) {
+            // occupy_grid fills [x, x+w] x [y, y+h]
+            ctx.dstar.notify_changed(dropped.x, dropped.y, dropped.x + dropped.width, dropped.y + dropped.height);
+#ifdef CHECK_REPLAN
+            check_replan(ctx, robot, goal);
+#endif
+        });
+    if (ctx.verbose) std::cout << ctx.dstar.nodes_expanded() << " nodes expanded in total" << std::endl;
+    return steps;
+}
+
+// Build a flow field from the goal once, then every step is one table lookup. A dropped
+// obstacle rebuilds the field, which any other robot heading to this goal would share
+static int drive_flow(episode_context& ctx, Object& robot, const Object& goal, episode_result& result)
+{
+    const goal_region region = robot_goal_region(robot, goal);
+    ctx.flow.build(ctx.grid, region, robot.width, robot.height, ctx.options.flow_threads);
+
+    return follow_steps(ctx, robot, goal, result,
+        [&](grid_point& next) { return ctx.flow.step(robot.x, robot.y, next); },
+        [&](const Object&) { ctx.flow.build(ctx.grid, region, robot.width, robot.height, ctx.options.flow_threads); });
+}
+
+// Generate a fresh map and drive the robot until it reaches the goal or runs out of steps.
+// Resets the context's grid, robot_pos and succeed so it can be called repeatedly.
+// The map comes from ctx.rand_gen, so seed it first to reproduce a run
+episode_result run_episode(episode_context& ctx)
+{
+    PROF_SCOPE(PHASE_EPISODE);
+    auto start = std::chrono::steady_clock::now();
+    episode_result result {ctx.rand_gen.seed(), false, 0, 0, 0, 0.0};
+
+    ctx.grid.clear();
+    ctx.robot_pos.clear();
+    ctx.succeed = false;
+
+    // Create robot, goal, and objects
+    Object robot, goal;
+    {
+        PROF_SCOPE(PHASE_MAP_GENERATION);
+        robot = ctx.grid.create_object(ctx.grid, ctx.rand_gen, robot_tol, 2*radius, 2*radius, robot_y_min, height-radius, 1, "robot");
+        goal = ctx.grid.create_object(ctx.grid, ctx.rand_gen, goal_tol, goal_width, goal_height, 0, goal_y_max, 3, "goal");
+        ctx.objects = ctx.grid.create_objects(ctx.rand_gen, occupancy_tol, num_objects, ctx.verbose);
+        for (const Object& object : ctx.objects) {
+            result.spawn_failures += (object.width == 0 && object.height == 0);
+        }
+        index_obstacles(ctx);
+    }
+
+    ctx.robot_init = robot;
+    ctx.goal_init = goal;
+
+    ctx.robot_pos.push_back({robot.x, robot.y});
+
+    if (ctx.verbose) std::cout << "Starting main loop" << std::endl;
+
+    {
+        PROF_SCOPE(PHASE_DRIVE);
+        switch (ctx.options.policy) {
+            case POLICY_GREEDY: result.steps = drive_greedy(ctx, robot, goal, result); break;
+            case POLICY_ASTAR:
+            case POLICY_JPS: result.steps = drive_planned(ctx, robot, goal, result); break;
+            case POLICY_DSTAR: result.steps = drive_dstar(ctx, robot, goal, result); break;
+            case POLICY_FLOW: result.steps = drive_flow(ctx, robot, goal, result); break;
+        }
+    }
+
+    result.success = ctx.succeed;
+    PROF_COUNT(COUNTER_EPISODES, 1);
+    PROF_COUNT(COUNTER_STEPS, result.steps);
+    PROF_COUNT(COUNTER_COLLISIONS, result.collisions);
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Policy from its command-line name; false if the name is unknown
+bool parse_policy(const std::string& name, motion_policy& policy)
+{
+    if (name == "greedy") {
+        policy = POLICY_GREEDY;
+    }
+    else if (name == "astar") {
+        policy = POLICY_ASTAR;
+    }
+    else if (name == "jps") {
+        policy = POLICY_JPS;
+    }
+    else if (name == "dstar") {
+        policy = POLICY_DSTAR;
+    }
+    else if (name == "flow") {
+        policy = POLICY_FLOW;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Collision model from its command-line name; false if the name is unknown
+bool parse_collision(const std::string& name, collision_model& collision)
+{
+    if (name == "box") {
+        collision = COLLISION_BOX;
+    }
+    else if (name == "circle") {
+        collision = COLLISION_CIRCLE;
+    }
+    else if (name == "objects") {
+        collision = COLLISION_OBJECTS;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Run episodes 0..n-1 on the given number of threads (0 = all cores). Each worker owns an
+// episode_context and claims the next unstarted episode from a shared counter, so threads
+// stuck on long episodes never hold up the rest. Results come back in episode order.
+// Episode k is seeded with stream_seed(base_seed, k), so results do not depend on thread count
+std::vector<episode_result> run_episodes(int n, int threads, uint64_t base_seed, const sim_options& options)
+{
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+        threads = (threads > 0) ? threads : 1;
+    }
+    threads = (threads > n) ? ((n > 0) ? n : 1) : threads;
+
+    std::vector<episode_result> results(n > 0 ? n : 0);
+    std::atomic<int> next_episode {0};
+
+    auto worker = [&]() {
+        episode_context ctx;
+        ctx.verbose = false;
+        ctx.options = options;
+        for (int i = next_episode++; i < n; i = next_episode++) {
+            ctx.rand_gen.seed(random_generator::stream_seed(base_seed, i));
+            results[i] = run_episode(ctx);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return results;
+}
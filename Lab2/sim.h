@@ -0,0 +1,101 @@
+// Lab 2 simulation core: map generation, robot motion and collision checks.
+// Nothing here depends on SFML, so the windowed lab and the headless runners share it
+#ifndef SIM
+#define SIM
+
+#include <string>
+#include <vector>
+#include "distance.h"
+#include "object_index.h"
+#include "obstacle_batch.h"
+#include "planner.h"
+#include "utils.h"
+
+//===== Main parameters =====
+const int width {800}, height {800};        // Width and height of the environment
+const int radius {10};                      // Radius of the robot's circular body
+const int min_obj_size {50};                // Minimum object dimension
+const int max_obj_size {100};               // Maximum object dimension
+const int goal_width {100};                 // Goal width
+const int goal_height {100};                // Goal height
+const int robot_tol {200};                  // Tolerance for robot spawn point
+const int occupancy_tol {50};               // Minimum distance between all objects that spawn
+const int goal_tol {100};                   // Minimum distance in x,y between robot and goal
+const int robot_y_min {500};                // Minimum robot y position
+const int goal_y_max {300};                 // Maximum goal y position
+const int num_objects {15};                 // Number of objects in environment
+const int max_steps {3600};                 // Step cap, one minute of playback at 60 fps
+const int late_drop_interval {40};          // Steps between obstacles dropped mid-run (sim_options::late_objects)
+const int late_drop_range {150};            // Late obstacles land within this distance of the robot
+
+// How the robot gets to the goal
+enum motion_policy {
+    POLICY_GREEDY,                          // Task 3 moves plus perpendicular obstacle avoidance
+    POLICY_ASTAR,                           // follow an A* path planned at spawn
+    POLICY_JPS,                             // same, planned with jump point search
+    POLICY_DSTAR,                           // D* Lite, repaired whenever an obstacle drops mid-run
+    POLICY_FLOW                             // next hop looked up in a flow field from the goal
+};
+
+// What counts as the robot's body in collision checks
+enum collision_model {
+    COLLISION_BOX,                          // the whole bounding box, scanned in the obstacle bitmap
+    COLLISION_CIRCLE,                       // the disc of `radius` against the obstacle rectangles
+    COLLISION_OBJECTS                       // the bounding box against the obstacle rectangles themselves
+};
+
+// Knobs shared by every episode of a run
+struct sim_options {
+    motion_policy policy;
+    collision_model collision;
+    int late_objects;                       // obstacles dropped near the robot while it moves
+    int flow_threads;                       // threads per flow field build, 0 = all cores
+};
+
+// Everything one episode touches. Each thread owns one and reuses it across episodes
+struct episode_context {
+    grid_util grid;                         // Grid utility class
+    random_generator rand_gen;              // Random generator
+    trajectory robot_pos;                   // Robot positions, one entry per rendered frame
+    std::vector<Object> objects;            // Obstacles of the current map
+    Object robot_init, goal_init;           // Spawn state, kept for rendering
+    bool succeed;                           // Did mission succeed?
+    bool verbose;                           // Per-step console logging
+    sim_options options;
+    astar_planner planner;                  // search state reused across episodes
+    jps_planner jps;
+    dstar_planner dstar;
+    flow_field flow;
+    distance_field clearance;               // COLLISION_CIRCLE past BATCH_SCAN_LIMIT obstacles
+    obstacle_batch batch;                   // obstacle rectangles for COLLISION_CIRCLE/OBJECTS, scanned with SIMD
+    object_index obstacles;                 // R-tree over the same, built past BATCH_SCAN_LIMIT obstacles
+    std::vector<grid_point> path;           // planned path, capacity reused across episodes
+
+    episode_context();
+};
+
+// Outcome of one generate -> plan -> move run
+struct episode_result {
+    uint64_t seed;                          // replay with: ./lab2 <seed>
+    bool success;
+    int steps;
+    int collisions;
+    int spawn_failures;                     // obstacles create_objects gave up on
+    double wall_ms;
+};
+
+bool is_goal_detected(const Object&, const Object&);
+bool is_collision(episode_context&, const Object&);
+// Build the collision backends of options.collision over ctx.objects; run_episode does this per map
+void index_obstacles(episode_context&);
+void obstacle_avoidance(episode_context&, Object&, const Object&, bool);
+void moveRobotTask3(episode_context&, Object&, const Object&);
+void moveRobotTask4(episode_context&, Object&, const Object&);
+goal_region robot_goal_region(const Object&, const Object&);
+
+episode_result run_episode(episode_context&);
+std::vector<episode_result> run_episodes(int, int, uint64_t, const sim_options&);
+bool parse_policy(const std::string&, motion_policy&);
+bool parse_collision(const std::string&, collision_model&);
+
+#endif
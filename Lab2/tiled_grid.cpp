@@ -0,0 +1,186 @@
+// Tiled, file-backed occupancy grid
+
+#include <algorithm>
+#include <iostream>
+#include "tiled_grid.h"
+
+// Map a sparse backing file at `path` big enough for every tile. The file is created (or
+// truncated) empty, so every tile starts as a hole that reads back as free cells. If the file
+// cannot be mapped the grid is left 0x0 and closed: reads see free cells, writes are dropped and
+// create_object(s) place nothing
+tiled_grid::tiled_grid(const std::string& path, int width, int height, int min, int max):
+    env_width(width), env_height(height), min_obj_size(min), max_obj_size(max),
+    tiles_x((width + TILE_SIZE - 1) >> TILE_SHIFT), tiles_y((height + TILE_SIZE - 1) >> TILE_SHIFT),
+    written_tiles(0)
+{
+    if (!mapping.create(path, tile_count()*TILE_BYTES)) {
+        std::cerr << "Could not create tiled grid file " << path << std::endl;
+        env_width = env_height = 0;
+        tiles_x = tiles_y = 0;
+        return;
+    }
+    occupied_count.assign(tile_count(), 0);
+    obstacle_count.assign(tile_count(), 0);
+    written.assign(tile_count(), 0);
+}
+
+cell_t tiled_grid::at(int x, int y) const {
+    if (!is_open()) {
+        return CELL_FREE;
+    }
+    const size_t t = tile_index(x >> TILE_SHIFT, y >> TILE_SHIFT);
+    if (occupied_count[t] == 0) {
+        return CELL_FREE;
+    }
+    return tile(t)[((x & (TILE_SIZE-1)) << TILE_SHIFT) | (y & (TILE_SIZE-1))];
+}
+
+Object tiled_grid::create_object(
+    random_generator &rand_gen,
+    int tol, int width, int height, int min, int max, int val,
+    std::string name)
+{
+    if (!is_open()) {
+        return Object{0, 0, 0, 0};
+    }
+    return place_object(*this, rand_gen, tol, width, height, min, max, val, name);
+}
+
+std::vector<Object> tiled_grid::create_objects(random_generator &rand_gen, int tol, int num_objects, bool verbose) {
+    if (!is_open()) {
+        return std::vector<Object>(num_objects, Object{0, 0, 0, 0});
+    }
+    return place_objects(*this, rand_gen, tol, num_objects, min_obj_size, max_obj_size, verbose);
+}
+
+// Same cell values as grid_util::occupy_grid: `val` inside the object, CELL_TOLERANCE on the free
+// cells of the band of width tol around it. Free values landing on a tile that was never written are dropped, so the
+// tile stays a hole
+void tiled_grid::occupy_grid (int tol, int x, int y, int obj_width, int obj_height, int val, std::string name)
+{
+    (void)name;
+    if (!is_open()) {
+        return;
+    }
+    int min_bnd_x = (x < tol) ? 0 : x-tol;
+    int min_bnd_y = (y < tol) ? 0 : y-tol;
+    //The object covers [x, x+obj_width] inclusive, so even with no band the bounds reach one past it
+    const int reach_x = std::max(x+obj_width+tol, x+obj_width+1);
+    const int reach_y = std::max(y+obj_height+tol, y+obj_height+1);
+    int max_bnd_x = (env_width < reach_x) ? env_width : reach_x;
+    int max_bnd_y = (env_height < reach_y) ? env_height : reach_y;
+    if (min_bnd_x >= max_bnd_x || min_bnd_y >= max_bnd_y) {
+        return;
+    }
+    const cell_t inside = static_cast<cell_t>(val);
+
+    for (int tx = min_bnd_x >> TILE_SHIFT; tx <= (max_bnd_x-1) >> TILE_SHIFT; tx++) {
+        const int i0 = std::max(min_bnd_x, tx << TILE_SHIFT);
+        const int i1 = std::min(max_bnd_x, (tx+1) << TILE_SHIFT);
+        for (int ty = min_bnd_y >> TILE_SHIFT; ty <= (max_bnd_y-1) >> TILE_SHIFT; ty++) {
+            const int j0 = std::max(min_bnd_y, ty << TILE_SHIFT);
+            const int j1 = std::min(max_bnd_y, (ty+1) << TILE_SHIFT);
+            const size_t t = tile_index(tx, ty);
+            cell_t* cells = tile(t);
+            int32_t occupied = occupied_count[t], obstacles = obstacle_count[t];
+            for (int i=i0; i<i1; i++) {
+                cell_t* col = cells + ((size_t)(i & (TILE_SIZE-1)) << TILE_SHIFT);
+                for (int j=j0; j<j1; j++) {
+                    cell_t v = inside;
+                    const bool band = (i<x) || (j<y) || (i>x+obj_width) || (j>y+obj_height);
+                    if (band) {
+                        v = CELL_TOLERANCE;
+                    }
+                    if (!written[t]) {
+                        if (v == CELL_FREE) {
+                            continue;
+                        }
+                        written[t] = 1;
+                        written_tiles++;
+                    }
+                    cell_t& c = col[j & (TILE_SIZE-1)];
+                    if (band && c != CELL_FREE) {
+                        continue;
+                    }
+                    occupied += (v != CELL_FREE) - (c != CELL_FREE);
+                    obstacles += (v == CELL_OBSTACLE) - (c == CELL_OBSTACLE);
+                    c = v;
+                }
+            }
+            occupied_count[t] = occupied;
+            obstacle_count[t] = obstacles;
+        }
+    }
+}
+
+// Does any cell of the inclusive box [x0,x1] x [y0,y1], clipped to the grid, have a non-zero
+// count in `counts`? Tiles with a zero count are skipped and tiles the box covers whole are
+// answered from the count; only the partly covered tiles at the edges are scanned. `obstacle`
+// picks which cells match, in step with the counter passed
+bool tiled_grid::tile_has (const std::vector<int32_t>& counts, uint8_t obstacle, int x0, int y0, int x1, int y1) const {
+    if (!is_open()) {
+        return false;
+    }
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= env_width) ? env_width-1 : x1;
+    y1 = (y1 >= env_height) ? env_height-1 : y1;
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    for (int tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; tx++) {
+        const int i0 = std::max(x0, tx << TILE_SHIFT) & (TILE_SIZE-1);
+        const int i1 = std::min(x1, ((tx+1) << TILE_SHIFT) - 1) & (TILE_SIZE-1);
+        for (int ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ty++) {
+            const size_t t = tile_index(tx, ty);
+            if (counts[t] == 0) {
+                continue;
+            }
+            const int j0 = std::max(y0, ty << TILE_SHIFT) & (TILE_SIZE-1);
+            const int j1 = std::min(y1, ((ty+1) << TILE_SHIFT) - 1) & (TILE_SIZE-1);
+            if (i0 == 0 && j0 == 0 && i1 == TILE_SIZE-1 && j1 == TILE_SIZE-1) {
+                return true;
+            }
+            const cell_t* cells = tile(t);
+            for (int i=i0; i<=i1; i++) {
+                const cell_t* col = cells + ((size_t)i << TILE_SHIFT);
+                for (int j=j0; j<=j1; j++) {
+                    if (obstacle ? col[j] == CELL_OBSTACLE : col[j] != CELL_FREE) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Check whether the inclusive box [x, x+width] x [y, y+height] touches any non-free cell,
+// the same box grid_util::is_occupied tests
+bool tiled_grid::is_occupied (int tol, int x, int y, int width, int height) const {
+    (void)tol;
+    return tile_has(occupied_count, 0, x, y, x+width, y+height);
+}
+
+// Does the inclusive box [x0,x1] x [y0,y1] (clipped to the grid) touch an obstacle cell?
+bool tiled_grid::box_has_obstacle (int x0, int y0, int x1, int y1) const {
+    return tile_has(obstacle_count, 1, x0, y0, x1, y1);
+}
+
+// Same corner test and return codes as grid_util::is_collision, without the console report
+int tiled_grid::is_collision (Object robot) const {
+    const bool top_left = obstacle_at(robot.x, robot.y);
+    const bool top_right = obstacle_at(robot.x+robot.width, robot.y);
+    const bool bottom_left = obstacle_at(robot.x, robot.y+robot.height);
+    const bool bottom_right = obstacle_at(robot.x+robot.width, robot.y+robot.height);
+    if (top_left) {
+        return top_right ? 1 : (bottom_left ? 2 : 5);
+    }
+    if (top_right) {
+        return bottom_right ? 4 : 6;
+    }
+    if (bottom_left) {
+        return bottom_right ? 3 : 7;
+    }
+    return bottom_right ? 8 : 0;
+}
@@ -0,0 +1,56 @@
+// Occupancy grid for maps too large to hold as one flat buffer. Cells live in 64x64 tiles of one
+// byte each (4 KiB, one page), laid out in a sparse file mapped into memory. A tile that only ever
+// held free cells is never written, so the file keeps a hole there and it costs neither disk nor
+// RAM; per-tile counters let queries skip such tiles without touching their pages
+#ifndef TILED_GRID
+#define TILED_GRID
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+const int TILE_SHIFT = 6;
+const int TILE_SIZE = 1 << TILE_SHIFT;                  // cells per tile side
+const size_t TILE_BYTES = (size_t)TILE_SIZE*TILE_SIZE;
+
+class tiled_grid {
+    int env_width, env_height, min_obj_size, max_obj_size;
+    int tiles_x, tiles_y;
+    //Backing file, tiles_x*tiles_y tiles in x-major order. Within a tile, cell (lx, ly) is at
+    //byte (lx << TILE_SHIFT) | ly, so a tile column is 64 contiguous cells along y
+    mapped_file mapping;
+    //Per tile: cells that are not free, and cells that hold an obstacle
+    std::vector<int32_t> occupied_count;
+    std::vector<int32_t> obstacle_count;
+    //Tiles whose page has been written at least once
+    std::vector<uint8_t> written;
+    size_t written_tiles;
+
+    size_t tile_index(int tx, int ty) const { return (size_t)tx*tiles_y + ty; }
+    cell_t* tile(size_t t) const { return reinterpret_cast<cell_t*>(mapping.data()) + t*TILE_BYTES; }
+    bool tile_has(const std::vector<int32_t>&, uint8_t, int, int, int, int) const;
+
+    public:
+        tiled_grid(const std::string&, int, int, int, int);
+        tiled_grid(const tiled_grid&) = delete;
+        tiled_grid& operator=(const tiled_grid&) = delete;
+        bool is_open() const { return mapping.data() != nullptr; }
+
+        int width() const { return env_width; }
+        int height() const { return env_height; }
+        cell_t at(int, int) const;
+        bool obstacle_at(int x, int y) const { return at(x, y) == CELL_OBSTACLE; }
+
+        Object create_object(random_generator&, int, int, int, int, int, int, std::string);
+        std::vector<Object> create_objects(random_generator&, int, int, bool = true);
+        void occupy_grid(int, int, int, int, int, int, std::string);
+        bool is_occupied(int, int, int, int, int) const;
+        bool box_has_obstacle(int, int, int, int) const;
+        int is_collision(Object) const;
+        // Tiles backed by a written page, out of tiles_x*tiles_y
+        size_t resident_tiles() const { return written_tiles; }
+        size_t tile_count() const { return (size_t)tiles_x*tiles_y; }
+};
+
+#endif
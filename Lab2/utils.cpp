@@ -1,26 +1,140 @@
 // utility classes and functions
 // All utility here only rely on already installed C++ libraries
 
+#include <algorithm>
 #include <random>
 #include "utils.h"
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-random_generator::random_generator(): gen(rd()) {}
+random_generator::random_generator(): engine(RNG_MT19937) { seed(random_seed()); }
 
+random_generator::random_generator(uint64_t s, rng_engine e): engine(e) { seed(s); }
+
+// Restart the generator; the same seed always reproduces the same sequence
+void random_generator::seed(uint64_t s) {
+    seed_value = s;
+    if (engine == RNG_XOSHIRO256) {
+        // Expand the seed with SplitMix64 as the xoshiro authors recommend
+        for (int i = 0; i < 4; i++) {
+            xs[i] = stream_seed(s, i);
+        }
+    }
+    else {
+        std::seed_seq seq {(uint32_t)s, (uint32_t)(s >> 32)};
+        gen.seed(seq);
+    }
+}
+
+// Fresh 64-bit seed from hardware
+uint64_t random_generator::random_seed() {
+    std::random_device rd;
+    return ((uint64_t)rd() << 32) | rd();
+}
+
+// Seed of independent stream number `stream` derived from `base` (SplitMix64 at that counter).
+// Depends only on (base, stream), so episode k gets the same map whatever thread runs it
+uint64_t random_generator::stream_seed(uint64_t base, uint64_t stream) {
+    uint64_t z = base + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Next 32 random bits from the selected engine
+inline uint32_t random_generator::next32() {
+    if (engine == RNG_XOSHIRO256) {
+        const uint64_t result = rotl(xs[1] * 5, 7) * 9;
+        const uint64_t t = xs[1] << 17;
+        xs[2] ^= xs[0];
+        xs[3] ^= xs[1];
+        xs[1] ^= xs[2];
+        xs[0] ^= xs[3];
+        xs[2] ^= t;
+        xs[3] = rotl(xs[3], 45);
+        return (uint32_t)(result >> 32);
+    }
+    return (uint32_t)gen();
+}
+
+// Uniform integer in [lower_bnd, upper_bnd]. Lemire's multiply-shift reduction: the high half of
+// bits*range is the result, and the rare low halves that would bias it are redrawn
 int random_generator::create_random(int lower_bnd, int upper_bnd) {
-    std::uniform_int_distribution<> distr(lower_bnd, upper_bnd); // define the range
-    return distr(gen);
+    const uint32_t range = (uint32_t)upper_bnd - (uint32_t)lower_bnd + 1;
+    if (range == 0) {
+        return (int)next32(); // full 32-bit range
+    }
+    uint64_t m = (uint64_t)next32() * range;
+    if ((uint32_t)m < range) {
+        const uint32_t threshold = (0u - range) % range;
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)next32() * range;
+        }
+    }
+    return lower_bnd + (int)(m >> 32);
+}
+
+// Fill out[0..n) with uniform integers in [lower_bnd, upper_bnd], same reduction as create_random
+void random_generator::fill_random(int* out, size_t n, int lower_bnd, int upper_bnd) {
+    const uint32_t range = (uint32_t)upper_bnd - (uint32_t)lower_bnd + 1;
+    if (range == 0) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = (int)next32();
+        }
+        return;
+    }
+    const uint32_t threshold = (0u - range) % range;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t m = (uint64_t)next32() * range;
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)next32() * range;
+        }
+        out[i] = lower_bnd + (int)(m >> 32);
+    }
 }
 
 grid_util::grid_util(int width, int height, int min_size, int max_size) : 
     env_width(width), 
     env_height(height),
     min_obj_size(min_size),
-    max_obj_size(max_size)
+    max_obj_size(max_size),
+    owned_cells((size_t)width*height, CELL_FREE),
+    cells(owned_cells.data()),
+    sat((size_t)(width+1)*(height+1), 0),
+    obstacle_bits((size_t)width*((height+63)/64), 0),
+    bit_words((height+63)/64),
+    footprint_w(-1),
+    footprint_h(-1),
+    grid(cells, height)
 {
-    grid = std::vector<std::vector<int>>(env_height, std::vector<int>(env_width, 0));
+    sat_pending.reserve(SAT_PENDING_LIMIT);
+    size_pyramid();
+}
+
+// Reset every cell and index to free so the same grid can host another episode
+void grid_util::clear() {
+    std::fill(cells, cells + (size_t)env_width*env_height, CELL_FREE);
+    std::fill(sat.begin(), sat.end(), 0);
+    sat_pending.clear();
+    std::fill(obstacle_bits.begin(), obstacle_bits.end(), 0);
+    std::fill(cspace_bits.begin(), cspace_bits.end(), 0);
+    for (std::vector<uint8_t>& level : pyramid) {
+        std::fill(level.begin(), level.end(), 0);
+    }
 }
 
 Object grid_util::create_object(
@@ -29,56 +143,13 @@ Object grid_util::create_object(
     int tol, int width, int height, int min, int max, int val, 
     std::string name) 
 {
-    Object rect;
-    int x = rand_gen.create_random(0, env_width-width);
-    int y = rand_gen.create_random(min, max);
-    while (grid.is_occupied(tol, x, y, width, height)) {
-        x = rand_gen.create_random(0, env_width);
-        y = rand_gen.create_random(min, max);
-    }
-    grid.occupy_grid(tol, x, y, width, height, val, name);
-    rect.x = x;
-    rect.y = y;
-    rect.width = width;
-    rect.height = height;
-    return rect;
-}
-
-std::vector<Object> grid_util::create_objects(random_generator &rand_gen, int tol, int num_objects) {
-    std::vector<Object>objects(num_objects);
+    return place_object(grid, rand_gen, tol, width, height, min, max, val, name);
+}
+
+std::vector<Object> grid_util::create_objects(random_generator &rand_gen, int tol, int num_objects, bool verbose) {
     // std::cout << "Creating " << num_objects << " rectangle objects in the environment" << std::endl;
-    int obj_x, obj_y, obj_width, obj_height;
-    bool limit_reached=false;
-    int max_iter = 0;
-    for (int i = 0; i < num_objects; i++) {
-        obj_x = rand_gen.create_random(tol, env_width-max_obj_size); //x
-        obj_y = rand_gen.create_random(tol, env_height-max_obj_size); //y
-        obj_width = rand_gen.create_random(min_obj_size, max_obj_size); //width
-        obj_height = rand_gen.create_random(min_obj_size, max_obj_size); //height
-        
-        while (this->is_occupied(tol, obj_x, obj_y, obj_width, obj_height)) {
-            obj_x = rand_gen.create_random(tol, env_width-max_obj_size); //x
-            obj_y = rand_gen.create_random(tol, env_height-max_obj_size); //y
-            obj_width = rand_gen.create_random(min_obj_size, max_obj_size); //width
-            obj_height = rand_gen.create_random(min_obj_size, max_obj_size); //height
-            max_iter++;
-            if (max_iter>=5000) {
-                limit_reached = true;
-                break;
-            }
-        }
-        max_iter = 0;
-        if (limit_reached) {
-            std::cout << "no space to spawn object number " << i+1 << " after 5000 tries." << std::endl;
-            limit_reached = false;
-            continue;
-        }
-        objects[i].x = obj_x; //x
-        objects[i].y = obj_y; //y
-        objects[i].width = obj_width; //width
-        objects[i].height = obj_height; //height
-        this->occupy_grid(tol, obj_x, obj_y, obj_width, obj_height, 2, "obstacle");
-    }
+    std::vector<Object> objects = place_objects(*this, rand_gen, tol, num_objects, min_obj_size, max_obj_size, verbose);
+    flush_sat();
     return objects;
 }
 
@@ -90,61 +161,407 @@ void grid_util::occupy_grid (int tol, int x, int y, int obj_width, int obj_heigh
     int min_bnd_y = (y < tol) ? 0 : y-tol;
 
     //Set max bounds in case x+tol or y+tol are out of bounds (seg fault!)
-    int max_bnd_x = (env_width < x+obj_width+tol) ? env_width : x+obj_width+tol;
-    int max_bnd_y = (env_height < y+obj_height+tol) ? env_height : y+obj_height+tol;
+    //The object covers [x, x+obj_width] inclusive, so even with no band the bounds reach one past it
+    const int reach_x = std::max(x+obj_width+tol, x+obj_width+1);
+    const int reach_y = std::max(y+obj_height+tol, y+obj_height+1);
+    int max_bnd_x = (env_width < reach_x) ? env_width : reach_x;
+    int max_bnd_y = (env_height < reach_y) ? env_height : reach_y;
 
+    // Walk in storage order: one contiguous row per x. The tolerance band only claims free cells,
+    // so it never erases part of an obstacle (or the robot or goal) placed earlier
     for (int i=min_bnd_x; i<max_bnd_x; i++) {
+        cell_t* r = row(i);
         for (int j=min_bnd_y; j<max_bnd_y; j++) {
-            if ((i<x) || (j<y)) {
-                grid[i][j] = -1;
-            }
-            else if ((i>x+obj_width) || (j>y+obj_height)) {
-                grid[i][j] = -1;
+            if ((i<x) || (j<y) || (i>x+obj_width) || (j>y+obj_height)) {
+                if (r[j] == CELL_FREE) {
+                    r[j] = CELL_TOLERANCE;
+                }
             }
             else {
-                grid[i][j] = val;
+                r[j] = static_cast<cell_t>(val);
             }
         }
     }
+    if (min_bnd_x >= max_bnd_x || min_bnd_y >= max_bnd_y) {
+        return;
+    }
+    // Unless the object itself is free, every cell of the region is now non-free
+    sat_pending.push_back(Object{min_bnd_x, min_bnd_y, max_bnd_x-1 - min_bnd_x, max_bnd_y-1 - min_bnd_y});
+    if (val == CELL_FREE || sat_pending.size() >= SAT_PENDING_LIMIT) {
+        flush_sat();
+    }
+    update_obstacle_bits(min_bnd_x, min_bnd_y, max_bnd_x, max_bnd_y);
+    update_pyramid(min_bnd_x, min_bnd_y, max_bnd_x, max_bnd_y);
+    if (footprint_w >= 0) {
+        // Positions whose body reaches into the rewritten cells
+        update_cspace(std::max(0, min_bnd_x - footprint_w), std::max(0, min_bnd_y - footprint_h), max_bnd_x, max_bnd_y);
+    }
     // std::cout << "Created " << name << " at: (" << x << ", " << y << ") with width " << obj_width << " and height " << obj_height << std::endl;
 }
 
-bool grid_util::is_occupied (int tol, int x, int y, int width, int height) {
-    int incr = min_obj_size+2*tol;
-    // Go over grids efficiently by incrementing by min_obj_size + tolerance
-    bool occupied;
-
-    // For all x
-    for (int i=x; i<x+width+1; i+=incr) {
-        // For all y
-        for (int j=y; j<y+height+1; j+=incr) {
-            occupied = (grid[i][j] != 0) ? true : false;
-            if (occupied == true) {
+// Recompute the summed-area table for every entry whose prefix includes a cell at or after (x0, y0)
+void grid_util::update_sat (int x0, int y0) {
+    if (x0 >= env_width || y0 >= env_height) {
+        return;
+    }
+    const size_t sat_stride = env_height+1;
+    for (int i=x0; i<env_width; i++) {
+        const cell_t* r = row(i);
+        int32_t* prev = &sat[(size_t)i*sat_stride];
+        int32_t* cur = &sat[(size_t)(i+1)*sat_stride];
+        for (int j=y0; j<env_height; j++) {
+            cur[j+1] = (r[j] != CELL_FREE) + prev[j+1] + cur[j] - prev[j];
+        }
+    }
+}
+
+// Bring the summed-area table up to date with every queued region in one pass from their
+// top-left-most corner
+void grid_util::flush_sat () {
+    if (sat_pending.empty()) {
+        return;
+    }
+    int x0 = env_width, y0 = env_height;
+    for (const Object& r : sat_pending) {
+        x0 = std::min(x0, r.x);
+        y0 = std::min(y0, r.y);
+    }
+    sat_pending.clear();
+    update_sat(x0, y0);
+}
+
+// Rebuild the summed-area table and obstacle bitmap from scratch after the cells were replaced
+void grid_util::rebuild_indexes() {
+    bit_words = (env_height+63)/64;
+    sat.assign((size_t)(env_width+1)*(env_height+1), 0);
+    sat_pending.clear();
+    obstacle_bits.assign((size_t)env_width*bit_words, 0);
+    update_sat(0, 0);
+    update_obstacle_bits(0, 0, env_width, env_height);
+    size_pyramid();
+    update_pyramid(0, 0, env_width, env_height);
+    if (footprint_w >= 0) {
+        cspace_bits.assign(obstacle_bits.size(), 0);
+        update_cspace(0, 0, env_width, env_height);
+    }
+}
+
+// Resync the obstacle bitmap with the cells in [x0,x1) x [y0,y1)
+void grid_util::update_obstacle_bits (int x0, int y0, int x1, int y1) {
+    for (int i=x0; i<x1; i++) {
+        const cell_t* r = row(i);
+        uint64_t* bits = &obstacle_bits[(size_t)i*bit_words];
+        for (int j=y0; j<y1; j++) {
+            const uint64_t bit = 1ULL << (j & 63);
+            if (r[j] == CELL_OBSTACLE) {
+                bits[j >> 6] |= bit;
+            }
+            else {
+                bits[j >> 6] &= ~bit;
+            }
+        }
+    }
+}
+
+// bits[i] |= bits[i+k] across word boundaries. Word w only reads words at or above w, and
+// word w itself before writing it, so the ascending in-place pass is safe
+static void or_shifted_down (uint64_t* bits, int words, int k) {
+    const int ws = k >> 6, bs = k & 63;
+    for (int w = 0; w + ws < words; w++) {
+        uint64_t v = bits[w + ws] >> bs;
+        if (bs && w + ws + 1 < words) {
+            v |= bits[w + ws + 1] << (64 - bs);
+        }
+        bits[w] |= v;
+    }
+}
+
+void dilate_bits_down (uint64_t* bits, int words, int span) {
+    // After each pass bit i covers [i, i+covered); finish with one partial shift
+    int covered = 1;
+    while (covered*2 <= span) {
+        or_shifted_down(bits, words, covered);
+        covered *= 2;
+    }
+    if (covered < span) {
+        or_shifted_down(bits, words, span - covered);
+    }
+}
+
+// Track a w x h body in the configuration-space layer, rebuilding it for the whole grid
+void grid_util::set_footprint (int w, int h) {
+    footprint_w = w;
+    footprint_h = h;
+    cspace_bits.assign(obstacle_bits.size(), 0);
+    update_cspace(0, 0, env_width, env_height);
+}
+
+// Recompute the configuration-space bits of positions [x0,x1) x [y0,y1) from the obstacle bitmap.
+// Each column ORs the obstacle columns under the body's width, then dilates along y by its height.
+// Only the words covering [y0, y1 + footprint_h] are touched
+void grid_util::update_cspace (int x0, int y0, int x1, int y1) {
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    const int w0 = y0 >> 6, w1 = (y1 - 1) >> 6;
+    const int src_end = std::min(bit_words - 1, (y1 - 1 + footprint_h) >> 6);
+    const int n = src_end - w0 + 1;
+    cspace_scratch.resize(n);
+    uint64_t* tmp = cspace_scratch.data();
+    for (int i=x0; i<x1; i++) {
+        std::fill(tmp, tmp + n, 0);
+        const int last = std::min(env_width - 1, i + footprint_w);
+        for (int k=i; k<=last; k++) {
+            const uint64_t* src = &obstacle_bits[(size_t)k*bit_words + w0];
+            for (int w=0; w<n; w++) {
+                tmp[w] |= src[w];
+            }
+        }
+        dilate_bits_down(tmp, n, footprint_h + 1);
+        uint64_t* dst = &cspace_bits[(size_t)i*bit_words];
+        for (int w=w0; w<=w1; w++) {
+            uint64_t mask = ~0ULL;
+            if (w == w0) {
+                mask &= ~0ULL << (y0 & 63);
+            }
+            if (w == w1 && (y1 & 63)) {
+                mask &= ~0ULL >> (64 - (y1 & 63));
+            }
+            dst[w] = (dst[w] & ~mask) | (tmp[w - w0] & mask);
+        }
+    }
+}
+
+// Allocate the pyramid levels for the current grid size, all flags clear
+void grid_util::size_pyramid () {
+    pyramid.clear();
+    pyramid_w.clear();
+    pyramid_h.clear();
+    int w = env_width, h = env_height;
+    while (w > 1 || h > 1) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        pyramid.emplace_back((size_t)w*h, 0);
+        pyramid_w.push_back(w);
+        pyramid_h.push_back(h);
+    }
+}
+
+// Re-pool every level over the blocks covering cells [x0,x1) x [y0,y1)
+void grid_util::update_pyramid (int x0, int y0, int x1, int y1) {
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    for (int k=1; k<=(int)pyramid.size(); k++) {
+        uint8_t* dst = pyramid[k-1].data();
+        const int dst_h = pyramid_h[k-1];
+        const int src_w = (k == 1) ? env_width : pyramid_w[k-2];
+        const int src_h = (k == 1) ? env_height : pyramid_h[k-2];
+        for (int i=x0>>k; i<=(x1-1)>>k; i++) {
+            for (int j=y0>>k; j<=(y1-1)>>k; j++) {
+                uint8_t flags = 0;
+                for (int a=2*i; a<=2*i+1 && a<src_w; a++) {
+                    for (int b=2*j; b<=2*j+1 && b<src_h; b++) {
+                        if (k == 1) {
+                            const cell_t v = cells[(size_t)a*env_height + b];
+                            flags |= ((v != CELL_FREE) ? PYRAMID_OCCUPIED : 0) | ((v == CELL_OBSTACLE) ? PYRAMID_OBSTACLE : 0);
+                        }
+                        else {
+                            flags |= pyramid[k-2][(size_t)a*src_h + b];
+                        }
+                    }
+                }
+                dst[(size_t)i*dst_h + j] = flags;
+            }
+        }
+    }
+}
+
+// Blocks at or below this level (64 x 64 cells) that straddle the box edge are finished with the
+// summed-area table or the obstacle bitmap, which beat descending further into single cells
+static const int PYRAMID_LEAF_LEVEL = 6;
+
+// Does block (i, j) of `level` have a cell carrying `flag` inside [x0,x1] x [y0,y1]? Blocks
+// without the flag are rejected and blocks wholly inside the box accepted without descending
+bool grid_util::block_has (uint8_t flag, int level, int i, int j, int x0, int y0, int x1, int y1) const {
+    if (level == 0) {
+        const cell_t v = cells[(size_t)i*env_height + j];
+        return (flag & PYRAMID_OBSTACLE) ? v == CELL_OBSTACLE : v != CELL_FREE;
+    }
+    if (!(pyramid_at(level, i, j) & flag)) {
+        return false;
+    }
+    const int bx0 = i << level, by0 = j << level;
+    const int bx1 = bx0 + (1 << level) - 1, by1 = by0 + (1 << level) - 1;
+    if (bx0 >= x0 && bx1 <= x1 && by0 >= y0 && by1 <= y1) {
+        return true;
+    }
+    if (level <= PYRAMID_LEAF_LEVEL) {
+        const int ax0 = std::max(bx0, x0), ay0 = std::max(by0, y0);
+        const int ax1 = std::min(bx1, x1), ay1 = std::min(by1, y1);
+        return (flag & PYRAMID_OBSTACLE) ? box_has_obstacle(ax0, ay0, ax1, ay1) : has_occupied(ax0, ay0, ax1, ay1);
+    }
+    const int half = 1 << (level-1);
+    for (int a=0; a<2; a++) {
+        const int cx = bx0 + a*half;
+        if (cx > x1 || cx + half - 1 < x0 || cx >= env_width) {
+            continue;
+        }
+        for (int b=0; b<2; b++) {
+            const int cy = by0 + b*half;
+            if (cy > y1 || cy + half - 1 < y0 || cy >= env_height) {
+                continue;
+            }
+            if (block_has(flag, level-1, 2*i+a, 2*j+b, x0, y0, x1, y1)) {
                 return true;
             }
         }
-        // Check if height%incr!=0 for the last y value of the object
-        if (height%incr!=0) {
-            occupied = (grid[i][y+height] != 0) ? true : false;
-            if (occupied == true) {
+    }
+    return false;
+}
+
+// Does any cell of the inclusive box [x0,x1] x [y0,y1], clipped to the grid, carry `flag`
+// (PYRAMID_OCCUPIED or PYRAMID_OBSTACLE)? Starts from the finest level at which the box spans
+// at most 2 x 2 blocks and only descends into blocks that straddle the box edge
+bool grid_util::box_has (uint8_t flag, int x0, int y0, int x1, int y1) const {
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= env_width) ? env_width-1 : x1;
+    y1 = (y1 >= env_height) ? env_height-1 : y1;
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    int level = 0;
+    while (level < (int)pyramid.size() && (((x1 >> level) - (x0 >> level)) > 1 || ((y1 >> level) - (y0 >> level)) > 1)) {
+        level++;
+    }
+    for (int i=x0>>level; i<=x1>>level; i++) {
+        for (int j=y0>>level; j<=y1>>level; j++) {
+            if (block_has(flag, level, i, j, x0, y0, x1, y1)) {
                 return true;
             }
         }
     }
-    // Check if width%incr!=0 for the last x value of the object
-    if (width%incr!=0) {
-        for (int j=y; j<y+height+1; j+=incr) {
-            occupied = (grid[x+width][j] != 0) ? true : false;
-            if (occupied == true) {
+    return false;
+}
+
+// Number of non-zero cells in the inclusive rectangle [x0,x1] x [y0,y1], clipped to the grid
+int grid_util::count_occupied (int x0, int y0, int x1, int y1) {
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= env_width) ? env_width-1 : x1;
+    y1 = (y1 >= env_height) ? env_height-1 : y1;
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+    flush_sat();
+    const size_t sat_stride = env_height+1;
+    const int32_t* lo = &sat[(size_t)x0*sat_stride];
+    const int32_t* hi = &sat[(size_t)(x1+1)*sat_stride];
+    return hi[y1+1] - hi[y0] - lo[y1+1] + lo[y0];
+}
+
+// Does the inclusive rectangle [x0,x1] x [y0,y1] hold a non-zero cell? Answered without flushing:
+// a queued region it overlaps is wholly non-free, and a cell outside every queued region reads
+// the same in the stale table. Cells only turn free through a flushed write, so stale counts
+// never report a free cell as taken
+bool grid_util::has_occupied (int x0, int y0, int x1, int y1) const {
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= env_width) ? env_width-1 : x1;
+    y1 = (y1 >= env_height) ? env_height-1 : y1;
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    const size_t sat_stride = env_height+1;
+    const int32_t* lo = &sat[(size_t)x0*sat_stride];
+    const int32_t* hi = &sat[(size_t)(x1+1)*sat_stride];
+    if (hi[y1+1] - hi[y0] - lo[y1+1] + lo[y0] > 0) {
+        return true;
+    }
+    for (const Object& r : sat_pending) {
+        if (r.x <= x1 && x0 <= r.x + r.width && r.y <= y1 && y0 <= r.y + r.height) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Exact test of every cell in [x, x+width] x [y, y+height] through the summed-area table.
+// tol is unused now; it only set the sampling stride of the old scan
+bool grid_util::is_occupied (int tol, int x, int y, int width, int height) {
+    (void)tol;
+    return has_occupied(x, y, x+width, y+height);
+}
+
+// True if any of words[w0..w1] has a bit set, with the first and last words masked
+static bool span_has_bits (const uint64_t* words, int w0, int w1, uint64_t first, uint64_t last) {
+    if (w0 == w1) {
+        return (words[w0] & first & last) != 0;
+    }
+    if ((words[w0] & first) | (words[w1] & last)) {
+        return true;
+    }
+    int w = w0+1;
+#ifdef __AVX2__
+    for (; w+4 <= w1; w += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words+w));
+        if (!_mm256_testz_si256(v, v)) {
+            return true;
+        }
+    }
+#endif
+    uint64_t any = 0;
+    for (; w < w1; w++) {
+        any |= words[w];
+    }
+    return any != 0;
+}
+
+// Does the inclusive box [x0,x1] x [y0,y1] (clipped to the grid) touch an obstacle cell?
+// Scans one masked word span per row of the obstacle bitmap instead of the byte cells.
+// Boxes wider than a pyramid leaf go through the pyramid first, which skips empty 64 x 64 blocks
+bool grid_util::box_has_obstacle (int x0, int y0, int x1, int y1) const {
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= env_width) ? env_width-1 : x1;
+    y1 = (y1 >= env_height) ? env_height-1 : y1;
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    if (x1 - x0 >= (1 << PYRAMID_LEAF_LEVEL)) {
+        return box_has(PYRAMID_OBSTACLE, x0, y0, x1, y1);
+    }
+    const int w0 = y0 >> 6, w1 = y1 >> 6;
+    const uint64_t first = ~0ULL << (y0 & 63);
+    const uint64_t last = ~0ULL >> (63 - (y1 & 63));
+    const uint64_t* p = &obstacle_bits[(size_t)x0*bit_words];
+    int x = x0;
+    if (w0 == w1) {
+        // Span fits in one word: test that word on several rows at once
+        const uint64_t mask = first & last;
+        p += w0;
+#ifdef __AVX2__
+        const __m256i vmask = _mm256_set1_epi64x((long long)mask);
+        const __m256i offsets = _mm256_set_epi64x(3LL*bit_words, 2LL*bit_words, bit_words, 0);
+        for (; x+3 <= x1; x += 4, p += 4*(size_t)bit_words) {
+            __m256i v = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(p), offsets, 8);
+            if (!_mm256_testz_si256(v, vmask)) {
                 return true;
             }
         }
-        if (height%incr!=0) {
-            occupied = (grid[x+width][y+height] != 0) ? true : false;
-            if (occupied == true) {
+#endif
+        for (; x <= x1; x++, p += bit_words) {
+            if (*p & mask) {
                 return true;
             }
         }
+        return false;
+    }
+    for (; x <= x1; x++, p += bit_words) {
+        if (span_has_bits(p, w0, w1, first, last)) {
+            return true;
+        }
     }
     return false;
 }
@@ -162,14 +579,14 @@ int grid_util::is_collision (Object robot) {
 
     // Check the corners. If one of them is occupied by obstacle, it's collision
     // top left
-    if (grid[robot.x][robot.y] == 2) {
+    if (obstacle_at(robot.x, robot.y)) {
         // top right
-        if (grid[robot.x+robot.width][robot.y] == 2) {
+        if (obstacle_at(robot.x+robot.width, robot.y)) {
             std::cout << "Collision at top, robot coordinates: " << robot.x << ", " << robot.y << std::endl;
             return 1;
         }
         // bottom left
-        if (grid[robot.x][robot.y+robot.height] == 2) {
+        if (obstacle_at(robot.x, robot.y+robot.height)) {
             std::cout << "Collision at left, robot coordinates: " << robot.x << ", " << robot.y << std::endl;
             return 2;
         }
@@ -179,9 +596,9 @@ int grid_util::is_collision (Object robot) {
         }
     }
     // top right
-    if (grid[robot.x+robot.width][robot.y] == 2) {
+    if (obstacle_at(robot.x+robot.width, robot.y)) {
         // bottom right
-        if (grid[robot.x+robot.width][robot.y+robot.height] == 2) {
+        if (obstacle_at(robot.x+robot.width, robot.y+robot.height)) {
             std::cout << "Collision at right, robot coordinates: " << robot.x << ", " << robot.y << std::endl;
             return 4;
         }
@@ -192,9 +609,9 @@ int grid_util::is_collision (Object robot) {
 
     }
     // bottom left
-    if (grid[robot.x][robot.y+robot.height] == 2) {
+    if (obstacle_at(robot.x, robot.y+robot.height)) {
         // bottom right
-        if (grid[robot.x+robot.width][robot.y+robot.height] == 2) {
+        if (obstacle_at(robot.x+robot.width, robot.y+robot.height)) {
             std::cout << "Collision at bottom, robot coordinates: " << robot.x << ", " << robot.y << std::endl;
             return 3;
         }
@@ -203,7 +620,7 @@ int grid_util::is_collision (Object robot) {
             return 7;
         }
     }
-    if (grid[robot.x+robot.width][robot.y+robot.height] == 2) {
+    if (obstacle_at(robot.x+robot.width, robot.y+robot.height)) {
         std::cout << "Collision at bottom right, robot coordinates: " << robot.x << ", " << robot.y << std::endl;
         return 8;
     }
@@ -231,36 +648,202 @@ int grid_util::is_collision (Object robot) {
 //     return 0;
 // }
 
-// Function to write a nested vector (grid) to a CSV file
-void grid_util::writeGridToCSV(const std::string& filename) {
-    std::ofstream file(filename);
+mapped_file::mapped_file(mapped_file&& other) noexcept: base(other.base), length(other.length) {
+    other.base = nullptr;
+    other.length = 0;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+        reset();
+        base = other.base;
+        length = other.length;
+        other.base = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+bool mapped_file::map(const std::string& filename) {
+    reset();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    base = static_cast<char*>(p);
+    length = (size_t)st.st_size;
+    return true;
+}
+
+// Create (or truncate) the file at `size` bytes and map it shared and writable, so stores reach
+// the file. ftruncate leaves the file sparse: pages never written take no disk space
+bool mapped_file::create(const std::string& filename, size_t size) {
+    reset();
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (size == 0 || ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    base = static_cast<char*>(p);
+    length = size;
+    return true;
+}
 
+void mapped_file::reset() {
+    if (base) {
+        munmap(base, length);
+        base = nullptr;
+        length = 0;
+    }
+}
+
+// Write a binary snapshot: header (dimensions, encoding, seed) then the raw cells in one block
+bool grid_util::save_binary(const std::string& filename, uint64_t seed) const {
+    std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
-        return;
+        return false;
     }
+    grid_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MTEGRID1", sizeof(header.magic));
+    header.header_size = sizeof(grid_file_header);
+    header.cell_encoding = GRID_ENCODING_INT8;
+    header.width = env_width;
+    header.height = env_height;
+    header.seed = seed;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(cells), (std::streamsize)env_width*env_height);
+    file.close();
+    if (!file) {
+        std::cerr << "Error: Could not write grid to " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    // Determine the maximum row size by finding the size of the longest inner vector
-    size_t maxRowSize = 0;
-    for (const auto& col : grid) {
-        if (col.size() > maxRowSize) {
-            maxRowSize = col.size();
-        }
+// Map a snapshot written by save_binary and use the mapped cells as this grid's storage.
+// Later edits are private to this process. Only the derived indexes are rebuilt in memory
+bool grid_util::load_binary(const std::string& filename, uint64_t* seed) {
+    mapped_file file;
+    if (!file.map(filename)) {
+        std::cerr << "Error: Could not map file " << filename << std::endl;
+        return false;
+    }
+    grid_file_header header;
+    if (file.size() < sizeof(header)) {
+        std::cerr << "Error: " << filename << " is not a grid snapshot" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "MTEGRID1", sizeof(header.magic)) != 0 ||
+        header.cell_encoding != GRID_ENCODING_INT8 ||
+        header.header_size < sizeof(header) || header.header_size % alignof(grid_file_header) != 0 ||
+        header.width <= 0 || header.height <= 0 ||
+        file.size() < header.header_size + (size_t)header.width*header.height) {
+        std::cerr << "Error: " << filename << " is not a grid snapshot" << std::endl;
+        return false;
     }
 
-    // Output the grid in transposed form (columns become rows in CSV)
-    for (size_t row = 0; row < maxRowSize; ++row) {
-        for (size_t col = 0; col < grid.size(); ++col) {
-            if (row < grid[col].size()) {
-                file << grid[col][row];
+    env_width = header.width;
+    env_height = header.height;
+    mapping = std::move(file);
+    owned_cells.clear();
+    owned_cells.shrink_to_fit();
+    cells = reinterpret_cast<cell_t*>(mapping.data() + header.header_size);
+    grid = grid_view(cells, env_height);
+    rebuild_indexes();
+    if (seed) {
+        *seed = header.seed;
+    }
+    return true;
+}
+
+// Format a small integer into out, returning the number of characters written
+static inline int format_int(char* out, int value) {
+    char digits[12];
+    int n = 0, len = 0;
+    unsigned int v = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+    if (value < 0) {
+        out[len++] = '-';
+    }
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) {
+        out[len++] = digits[--n];
+    }
+    return len;
+}
+
+// Function to write the grid to a CSV file, one line per y (the grid transposed).
+// Cells are transposed a band of rows at a time so reads follow storage order, formatted by hand
+// into a chunk_bytes buffer and streamed out a chunk at a time. filename "-" writes to stdout
+void grid_util::writeGridToCSV(const std::string& filename, size_t chunk_bytes) {
+    const bool to_stdout = (filename == "-");
+    std::FILE* file = to_stdout ? stdout : std::fopen(filename.c_str(), "wb");
+
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return;
+    }
+
+    const int max_cell_chars = 5; // "-128,"
+    const int band = 64;
+    chunk_bytes = (chunk_bytes < (size_t)max_cell_chars+1) ? (size_t)max_cell_chars+1 : chunk_bytes;
+    std::vector<char> out(chunk_bytes);
+    std::vector<cell_t> tile((size_t)band*env_width);
+    size_t pos = 0;
+    bool ok = true;
+
+    for (int y0 = 0; y0 < env_height; y0 += band) {
+        const int rows = (env_height - y0 < band) ? env_height - y0 : band;
+        // Transpose the band: contiguous reads along each x row, writes into per-line slots
+        for (int x = 0; x < env_width; ++x) {
+            const cell_t* r = row(x) + y0;
+            for (int k = 0; k < rows; ++k) {
+                tile[(size_t)k*env_width + x] = r[k];
             }
-            if (col < grid.size() - 1) {
-                file << ","; // Add comma except after the last element
+        }
+        for (int k = 0; k < rows; ++k) {
+            const cell_t* line = &tile[(size_t)k*env_width];
+            for (int x = 0; x < env_width; ++x) {
+                if (pos + max_cell_chars > out.size()) {
+                    ok = ok && std::fwrite(out.data(), 1, pos, file) == pos;
+                    pos = 0;
+                }
+                pos += format_int(&out[pos], line[x]);
+                out[pos++] = (x < env_width - 1) ? ',' : '\n'; // Comma except after the last element
             }
         }
-        file << "\n"; // New line after each row
     }
+    ok = ok && std::fwrite(out.data(), 1, pos, file) == pos;
+    ok = (to_stdout ? std::fflush(file) : std::fclose(file)) == 0 && ok;
 
-    file.close();
-    std::cout << "Grid written to " << filename << std::endl;
+    if (!ok) {
+        std::cerr << "Error: Could not write grid to " << filename << std::endl;
+        return;
+    }
+    if (!to_stdout) {
+        std::cout << "Grid written to " << filename << std::endl;
+    }
 }
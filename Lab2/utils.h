@@ -3,36 +3,298 @@
 #ifndef UTIL
 #define UTIL
 
+#include <cstdint>
 #include <random>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "instrument.h"
 
 struct Object {
     int x, y, width, height;
 };
 
+// Non-owning read-only view of a contiguous array (a C++17 stand-in for std::span).
+// Converts from std::vector, trajectory or anything else with data() and size()
+template <typename T>
+class array_view {
+    const T* ptr;
+    size_t count;
+    public:
+        array_view(): ptr(nullptr), count(0) {}
+        array_view(const T* p, size_t n): ptr(p), count(n) {}
+        template <typename C>
+        array_view(const C& c): ptr(c.data()), count(c.size()) {}
+        const T* data() const { return ptr; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T& operator[](size_t i) const { return ptr[i]; }
+        const T* begin() const { return ptr; }
+        const T* end() const { return ptr + count; }
+};
+
+// One robot position sample
+struct traj_point {
+    int32_t x, y;
+};
+
+// Robot positions in one flat buffer of x,y pairs. clear() keeps the capacity, so a reused
+// trajectory appends without allocating once it has grown to the longest run
+class trajectory {
+    std::vector<traj_point> points;
+    public:
+        trajectory() {}
+        explicit trajectory(size_t capacity) { points.reserve(capacity); }
+        void reserve(size_t capacity) { points.reserve(capacity); }
+        void clear() { points.clear(); }
+        // Append a sample, dropping it if it repeats the previous one
+        void push_back(const traj_point& p) {
+            if (points.empty() || points.back().x != p.x || points.back().y != p.y) {
+                points.push_back(p);
+            }
+        }
+        size_t size() const { return points.size(); }
+        bool empty() const { return points.empty(); }
+        const traj_point& operator[](size_t i) const { return points[i]; }
+        const traj_point& back() const { return points.back(); }
+        const traj_point* data() const { return points.data(); }
+};
+
+// Engines behind random_generator. xoshiro256** has 32 bytes of state against mt19937's 2.5 KB
+enum rng_engine {
+    RNG_MT19937,
+    RNG_XOSHIRO256
+};
+
 class random_generator {
-    std::random_device rd;                  // obtain a random number from hardware
-    std::mt19937 gen;                       // seed the generator
+    rng_engine engine;
+    std::mt19937 gen;                       // seeded from seed_value
+    uint64_t xs[4];                         // xoshiro256** state
+    uint64_t seed_value;                    // recorded so any map can be regenerated
     int env_size;   
+    uint32_t next32();
     public:
-        random_generator();
+        random_generator();                 // seed from hardware (std::random_device)
+        explicit random_generator(uint64_t, rng_engine = RNG_MT19937);
+        void seed(uint64_t);
+        uint64_t seed() const { return seed_value; }
+        static uint64_t random_seed();
+        static uint64_t stream_seed(uint64_t, uint64_t);
         int create_random(int, int);
+        void fill_random(int*, size_t, int, int);
+};
+
+// One byte per occupancy cell. Signed so tolerance keeps its old -1 value
+typedef int8_t cell_t;
+
+enum cell_value : cell_t {
+    CELL_TOLERANCE = -1,
+    CELL_FREE = 0,
+    CELL_ROBOT = 1,
+    CELL_OBSTACLE = 2,
+    CELL_GOAL = 3
+};
+
+// Compatibility view over the flat grid buffer so grid.grid[x][y] keeps working. Writes through
+// it go straight to the cells and bypass every index grid_util keeps (summed-area table, obstacle
+// bitmap, C-space layer, pyramid); change cells with occupy_grid instead
+class grid_view {
+    cell_t* data;
+    int stride;
+    public:
+        grid_view(): data(nullptr), stride(0) {}
+        grid_view(cell_t* d, int s): data(d), stride(s) {}
+        cell_t* operator[](int x) const { return data + (size_t)x*stride; }
+};
+
+// Private read-write mapping of a whole file. Writes stay in memory (copy-on-write), the
+// file on disk never changes. Unmapped on destruction
+class mapped_file {
+    char* base;
+    size_t length;
+    public:
+        mapped_file(): base(nullptr), length(0) {}
+        ~mapped_file() { reset(); }
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&&) noexcept;
+        mapped_file& operator=(mapped_file&&) noexcept;
+        bool map(const std::string&);
+        bool create(const std::string&, size_t);
+        void reset();
+        char* data() const { return base; }
+        size_t size() const { return length; }
+};
+
+// Header of the binary grid snapshot (grid_util::save_binary / load_binary), followed
+// directly by width*height cells in grid_util's x-major layout
+struct grid_file_header {
+    char magic[8];                          // "MTEGRID1"
+    uint32_t header_size;                   // bytes before the first cell, at least sizeof(grid_file_header) and 8-byte aligned
+    uint32_t cell_encoding;                 // GRID_ENCODING_INT8
+    int32_t width, height;
+    uint64_t seed;                          // RNG seed the map was generated from
+    uint64_t reserved[4];
 };
+const uint32_t GRID_ENCODING_INT8 = 1;      // one cell_value per byte
+
+// Dilate a column of bits toward lower positions: afterwards bit i is the OR of the old bits
+// i..i+span-1. Takes log2(span) shifted ORs over the words
+void dilate_bits_down(uint64_t*, int, int);
+
+// Flags pooled by the occupancy pyramid
+const uint8_t PYRAMID_OCCUPIED = 1;         // some cell in the block is not free
+const uint8_t PYRAMID_OBSTACLE = 2;         // some cell in the block holds an obstacle
+
+// Regions occupy_grid queues before it refreshes the summed-area table; queries test the queue
+// linearly, so it stays short
+const size_t SAT_PENDING_LIMIT = 32;
 
 class grid_util {
     int env_width, env_height, min_obj_size, max_obj_size;
-    //Occupancy grid; outer vector represents rows, inner represents columns along each row, initialized to 0's
+    //Occupancy grid in one contiguous buffer, initialized to 0's.
+    //Rows are indexed by x, each row holds env_height cells along y (row stride = env_height).
+    //cells points into owned_cells, or into mapping after load_binary
+    std::vector<cell_t> owned_cells;
+    mapped_file mapping;
+    cell_t* cells;
+    //Summed-area table of non-zero cells, (env_width+1) x (env_height+1) with a zero border.
+    //sat[(x+1)*(env_height+1) + y+1] counts occupied cells in [0,x] x [0,y].
+    //Refreshing it costs the area below and right of the first changed cell, so occupy_grid
+    //defers it: each written region is queued in sat_pending (every cell there is non-free
+    //afterwards) and the table is brought up to date once per flush_sat
+    std::vector<int32_t> sat;
+    std::vector<Object> sat_pending;
+    void update_sat(int, int);
+    void flush_sat();
+    bool has_occupied(int, int, int, int) const;
+    //One bit per cell, set where the cell holds an obstacle. Same x-major layout as cells,
+    //each row padded to bit_words 64-bit words
+    std::vector<uint64_t> obstacle_bits;
+    int bit_words;
+    void update_obstacle_bits(int, int, int, int);
+    //Configuration-space layer for one body size: bit (x, y) is set where a body covering
+    //[x, x+footprint_w] x [y, y+footprint_h] would touch an obstacle (clipped to the grid like
+    //box_has_obstacle), so planners and collision checks can treat the body as a point.
+    //Same layout as obstacle_bits; off until set_footprint, then kept in sync by occupy_grid
+    std::vector<uint64_t> cspace_bits;
+    std::vector<uint64_t> cspace_scratch;
+    int footprint_w, footprint_h;
+    void update_cspace(int, int, int, int);
+    //Max-pooled occupancy pyramid. pyramid[k-1] is level k: cell (i, j) ORs the flags of the
+    //2^k x 2^k block of cells starting at (i<<k, j<<k), halving until one cell is left.
+    //Level 0 is the cells themselves. Same x-major layout, stride pyramid_h[k-1]
+    std::vector<std::vector<uint8_t>> pyramid;
+    std::vector<int> pyramid_w, pyramid_h;
+    void size_pyramid();
+    void update_pyramid(int, int, int, int);
+    bool block_has(uint8_t, int, int, int, int, int, int, int) const;
+    void rebuild_indexes();
     
     public:
-        std::vector<std::vector<int>> grid;
+        grid_view grid;                     // raw cell access, bypasses the indexes
         grid_util(int, int, int, int);
+        void clear();
+        // The view points into cells, so copies would alias; moves keep the buffer in place
+        grid_util(const grid_util&) = delete;
+        grid_util& operator=(const grid_util&) = delete;
+        grid_util(grid_util&&) = default;
+        grid_util& operator=(grid_util&&) = default;
+        bool save_binary(const std::string&, uint64_t) const;
+        bool load_binary(const std::string&, uint64_t* = nullptr);
+
+        int width() const { return env_width; }
+        int height() const { return env_height; }
+        int stride() const { return env_height; }
+        cell_t* row(int x) { return cells + (size_t)x*env_height; }
+        const cell_t* row(int x) const { return cells + (size_t)x*env_height; }
+        cell_t at(int x, int y) const { return cells[(size_t)x*env_height + y]; }
+
         Object create_object(grid_util &, random_generator&, int, int, int, int, int, int, std::string);
-        std::vector<Object> create_objects (random_generator&, int, int);
+        std::vector<Object> create_objects (random_generator&, int, int, bool = true);
         void occupy_grid (int, int, int, int, int, int, std::string); 
         bool is_occupied (int, int, int, int, int);
+        int count_occupied (int, int, int, int);
+        bool obstacle_at (int x, int y) const { return (obstacle_bits[(size_t)x*bit_words + (y >> 6)] >> (y & 63)) & 1; }
+        bool box_has_obstacle (int, int, int, int) const;
+        const uint64_t* obstacle_row (int x) const { return &obstacle_bits[(size_t)x*bit_words]; }
+        int obstacle_row_words () const { return bit_words; }
+        void set_footprint (int, int);
+        bool has_footprint (int w, int h) const { return footprint_w == w && footprint_h == h; }
+        bool cspace_at (int x, int y) const { return (cspace_bits[(size_t)x*bit_words + (y >> 6)] >> (y & 63)) & 1; }
+        const uint64_t* cspace_row (int x) const { return &cspace_bits[(size_t)x*bit_words]; }
+        int pyramid_levels () const { return (int)pyramid.size(); }
+        uint8_t pyramid_at (int level, int i, int j) const { return pyramid[level-1][(size_t)i*pyramid_h[level-1] + j]; }
+        bool box_has (uint8_t, int, int, int, int) const;
         int is_collision(Object);
-        void writeGridToCSV(const std::string&);
+        void writeGridToCSV(const std::string&, size_t = 1 << 20);
 };
 
 
+// Rejection-sample one width x height object with its y in [min, max] into any grid with
+// is_occupied/occupy_grid (grid_util, tiled_grid), then occupy it with val. Retries until a spot is free
+template <typename G>
+Object place_object(G& grid, random_generator& rand_gen, int tol, int width, int height, int min, int max, int val, std::string name) {
+    Object rect;
+    int x = rand_gen.create_random(0, grid.width()-width);
+    int y = rand_gen.create_random(min, max);
+    while (grid.is_occupied(tol, x, y, width, height)) {
+        x = rand_gen.create_random(0, grid.width());
+        y = rand_gen.create_random(min, max);
+        PROF_COUNT(COUNTER_PLACEMENT_RETRIES, 1);
+    }
+    grid.occupy_grid(tol, x, y, width, height, val, name);
+    rect.x = x;
+    rect.y = y;
+    rect.width = width;
+    rect.height = height;
+    return rect;
+}
+
+// Rejection-sample num_objects obstacle rectangles into any grid with is_occupied/occupy_grid
+// (grid_util, tiled_grid). An object that finds no space after 5000 tries is skipped and left
+// zero-sized in the result, and reported on std::cerr when verbose
+template <typename G>
+std::vector<Object> place_objects(G& grid, random_generator& rand_gen, int tol, int num_objects, int min_obj_size, int max_obj_size, bool verbose = true) {
+    std::vector<Object>objects(num_objects);
+    int obj_x, obj_y, obj_width, obj_height;
+    int obj_size[2];
+    bool limit_reached=false;
+    int max_iter = 0;
+    for (int i = 0; i < num_objects; i++) {
+        obj_x = rand_gen.create_random(tol, grid.width()-max_obj_size); //x
+        obj_y = rand_gen.create_random(tol, grid.height()-max_obj_size); //y
+        rand_gen.fill_random(obj_size, 2, min_obj_size, max_obj_size); //width, height
+        obj_width = obj_size[0];
+        obj_height = obj_size[1];
+        
+        while (grid.is_occupied(tol, obj_x, obj_y, obj_width, obj_height)) {
+            obj_x = rand_gen.create_random(tol, grid.width()-max_obj_size); //x
+            obj_y = rand_gen.create_random(tol, grid.height()-max_obj_size); //y
+            rand_gen.fill_random(obj_size, 2, min_obj_size, max_obj_size); //width, height
+            obj_width = obj_size[0];
+            obj_height = obj_size[1];
+            PROF_COUNT(COUNTER_PLACEMENT_RETRIES, 1);
+            max_iter++;
+            if (max_iter>=5000) {
+                limit_reached = true;
+                break;
+            }
+        }
+        max_iter = 0;
+        if (limit_reached) {
+            PROF_COUNT(COUNTER_PLACEMENT_FAILURES, 1);
+            if (verbose) std::cerr << "no space to spawn object number " << i+1 << " after 5000 tries." << std::endl;
+            limit_reached = false;
+            continue;
+        }
+        objects[i].x = obj_x; //x
+        objects[i].y = obj_y; //y
+        objects[i].width = obj_width; //width
+        objects[i].height = obj_height; //height
+        grid.occupy_grid(tol, obj_x, obj_y, obj_width, obj_height, 2, "obstacle");
+    }
+    return objects;
+}
+
 #endif
\ No newline at end of file